@@ -0,0 +1,146 @@
+#include<iostream>
+#include<iomanip>
+#include<cstdlib>
+#include<cstring>
+#include<string>
+#include<cerrno>
+#include<chrono>
+#include<stdexcept>
+#include<unistd.h>
+
+#include "vfs.hpp"
+#include "batch.hpp"
+
+using namespace std;
+
+BatchOutput::BatchOutput(int out_fd) : fd(out_fd), written(0) {
+    buffer.reserve(BATCH_FLUSH_BYTES + BATCH_FLUSH_BYTES / 8);
+}
+
+int BatchOutput::overflow(int c) {
+    if (c != EOF) {
+        buffer += (char)c;
+        if (buffer.length() >= BATCH_FLUSH_BYTES) { flush_now(); }
+    }
+    return c;
+}
+
+streamsize BatchOutput::xsputn(const char* s, streamsize n) {
+    buffer.append(s, n);
+    if (buffer.length() >= BATCH_FLUSH_BYTES) { flush_now(); }
+    return n;
+}
+
+void BatchOutput::flush_now() {
+    size_t done = 0;
+    while (done < buffer.length()) {
+        ssize_t count = write(fd, buffer.data() + done, buffer.length() - done);
+        if (count < 0 && errno == EINTR) { continue; }
+        if (count <= 0) { break; }
+        done += count;
+    }
+    written += done;
+    buffer.clear();
+}
+
+// Splits a line into the command, the first parameter and the rest of the line, without copying
+void split_tokens(const char* line, size_t length, Token& command, Token& parameter1, Token& parameter2) {
+    const char* end = line + length;
+    const char* space = static_cast<const char*>(memchr(line, ' ', length));
+    if (space == nullptr) {
+        command = Token(line, length);
+        parameter1 = Token();
+        parameter2 = Token();
+        return;
+    }
+    command = Token(line, space - line);
+    const char* start = space + 1;
+    space = static_cast<const char*>(memchr(start, ' ', end - start));
+    if (space == nullptr) {
+        parameter1 = Token(start, end - start);
+        parameter2 = Token();
+        return;
+    }
+    parameter1 = Token(start, space - start);
+    parameter2 = Token(space + 1, end - space - 1);
+}
+
+//Runs the commands of a script read from a file descriptor. The script is read in large chunks and split
+//in place. execute takes strings, so the command and its parameters are copied into strings reused from one
+//line to the next: a line costs no allocation once they have grown, but it is not zero-copy
+int run_batch(VFS& vfs, int in_fd) {
+    BatchOutput output(STDOUT_FILENO);
+    ostream out(&output);
+    Session* session = vfs.open_session(out);
+
+    typedef chrono::steady_clock Clock;
+    Clock::time_point begin = Clock::now();
+    unsigned long long commands = 0, errors = 0;
+    bool running = true;
+    string command, parameter1, parameter2;
+    Token tokens[3];
+
+    string chunk(BATCH_READ_CHUNK, '\0');
+    char* buffer = &chunk[0];
+    size_t used = 0;                //bytes in the buffer, the first ones may be a line started in the previous chunk
+    bool done = false, too_long = false;
+    string read_error;              //set when the script can't be read to the end
+    while (running && !done && !too_long) {
+        ssize_t count = read(in_fd, buffer + used, BATCH_READ_CHUNK - used);
+        if (count < 0 && errno == EINTR) { continue; }
+        if (count < 0) {
+            read_error = strerror(errno);
+            break;
+        }
+        if (count == 0) {
+            //the last line may not end with a newline
+            done = true;
+            if (used == 0) { break; }
+            buffer[used++] = '\n';
+        } else {
+            used += count;
+        }
+        //run every complete line of the buffer
+        const char* line = buffer;
+        const char* end = buffer + used;
+        while (running) {
+            const char* newline = static_cast<const char*>(memchr(line, '\n', end - line));
+            if (newline == nullptr) { break; }
+            size_t length = newline - line;
+            if (length > 0 && line[length - 1] == '\r') { length--; }
+            if (length > 0) {
+                split_tokens(line, length, tokens[0], tokens[1], tokens[2]);
+                commands++;
+                //clear only makes sense on a terminal
+                if (!(tokens[0] == "clear")) {
+                    command.assign(tokens[0].data, tokens[0].length);
+                    parameter1.assign(tokens[1].data, tokens[1].length);
+                    parameter2.assign(tokens[2].data, tokens[2].length);
+                    try {
+                        running = vfs.execute(*session, command, parameter1, parameter2);
+                    } catch (exception &e) {
+                        errors++;
+                        out << "Exception: " << e.what() << '\n';
+                    }
+                }
+            }
+            line = newline + 1;
+        }
+        //keep the incomplete last line for the next chunk
+        used = end - line;
+        memmove(buffer, line, used);
+        too_long = used == BATCH_READ_CHUNK;
+    }
+    output.flush_now();
+    vfs.close_session(session);
+    if (too_long) { throw runtime_error("Line longer than " + to_string(BATCH_READ_CHUNK) + " bytes in the script"); }
+    if (!read_error.empty()) { throw runtime_error("Cannot read the script: " + read_error); }
+
+    double seconds = chrono::duration<double>(Clock::now() - begin).count();
+    cerr << commands << " command(s) in " << fixed << setprecision(3) << seconds << " s, "
+         << setprecision(0) << (seconds > 0 ? commands / seconds : 0) << " commands/s, "
+         << output.bytes() << " bytes of output";
+    if (errors > 0) { cerr << ", " << errors << " error(s)"; }
+    cerr << endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,49 @@
+#ifndef BATCH_H
+#define BATCH_H
+#include<cstdlib>
+#include<cstring>
+#include<string>
+#include<streambuf>
+#include "vfs.hpp"
+
+using namespace std;
+
+#define BATCH_READ_CHUNK (1 << 20)		//bytes of script read at once
+#define BATCH_FLUSH_BYTES (8 << 20)		//the output is written out when it grows past this
+
+//Part of a line of the script: a pointer into the read buffer and a length, nothing is copied
+struct Token
+{
+	const char* data;
+	size_t length;
+
+	Token() : data(""), length(0) {}
+	Token(const char* d, size_t l) : data(d), length(l) {}
+	bool operator==(const char* other) const { return strlen(other) == length && memcmp(data, other, length) == 0; }
+	bool empty() const { return length == 0; }
+};
+
+//Output of a batch: collects everything in one large buffer and only writes it out when it is full or
+//when the batch ends. std::endl still flushes the stream but doesn't reach the file descriptor
+class BatchOutput : public streambuf
+{
+	private:
+		int fd;							//where the output goes
+		string buffer;					//output not written yet
+		unsigned long long written;		//bytes written so far
+
+	protected:
+		int overflow(int c);
+		streamsize xsputn(const char* s, streamsize n);
+		int sync() { return 0; }
+
+	public:
+		BatchOutput(int out_fd);
+		void flush_now();				//Write the buffer out
+		unsigned long long bytes() const { return written + buffer.length(); }
+};
+
+void split_tokens(const char* line, size_t length, Token& command, Token& parameter1, Token& parameter2);	//Split a line like the console
+int run_batch(VFS& vfs, int in_fd);	//Run a script without prompts, report the throughput on stderr
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef BIN_H
+#define BIN_H
+
+#include<cstdlib>
+#include<string>
+#include "queue.hpp"
+#include "hashmap.hpp"
+using namespace std;
+
+class Inode;
+
+//An item of the bin
+struct BinRecord
+{
+	Inode* inode;				//root of the removed subtree
+	string path;				//path the item was removed from
+	Inode* parent;				//folder the item was removed from
+	unsigned long long bytes;	//total size of the removed subtree
+	long long seq;				//sequence number of the record in the bin
+	long long prev_same;		//sequence number of the previous record with the same path, -1 if none
+	bool live;					//false once the record was recovered out of order
+
+	BinRecord() : inode(nullptr), parent(nullptr), bytes(0), seq(-1), prev_same(-1), live(false) {}
+};
+
+//Recycle bin: the records in removal order in a growable ring buffer, plus an index of the newest
+//record for every path so that any item can be recovered by its path in O(1)
+class Bin
+{
+	private:
+		Queue<BinRecord> records;			//records, oldest first, including dead ones not at the front yet
+		long long head_seq;					//sequence number of records.at(0)
+		HashMap<string, long long> by_path;	//newest live record for each path
+		int live_count;						//number of live records
+		unsigned long long live_bytes;		//total size of the live records
+
+		BinRecord& record(long long seq) { return records.at((int)(seq - head_seq)); }
+		void drop_dead_front();				//Pop the dead records at the front
+
+	public:
+		Bin() : records(16, true), head_seq(0), live_count(0), live_bytes(0) {}
+
+		void push(Inode* inode, const string& path, Inode* parent, unsigned long long bytes);	//Add an item
+		BinRecord& front();					//Oldest item, the bin must not be empty
+		BinRecord* find(const string& path);	//Newest item removed from this path, nullptr if none
+		Inode* remove(BinRecord& item);		//Take an item out of the bin and return its Inode
+		bool empty() const { return live_count == 0; }
+		int size() const { return live_count; }
+		unsigned long long bytes() const { return live_bytes; }
+		int length() { return records.length(); }		//Number of records, including the dead ones
+		BinRecord& at(int i) { return records.at(i); }	//i-th record from the oldest, check live before using it
+};
+
+inline void Bin::push(Inode* inode, const string& path, Inode* parent, unsigned long long bytes) {
+    BinRecord item;
+    item.inode = inode;
+    item.path = path;
+    item.parent = parent;
+    item.bytes = bytes;
+    item.seq = head_seq + records.length();
+    item.live = true;
+    // Chain the record to the previous one removed from the same path
+    long long* newest = by_path.find(path);
+    item.prev_same = (newest != nullptr) ? *newest : -1;
+    by_path[path] = item.seq;
+    records.enqueue(std::move(item));
+    live_count++;
+    live_bytes += bytes;
+}
+
+inline BinRecord& Bin::front() {
+    if (empty()) { throw QueueEmpty(); }
+    return records.at(0);
+}
+
+inline BinRecord* Bin::find(const string& path) {
+    long long* newest = by_path.find(path);
+    if (newest == nullptr) { return nullptr; }
+    return &record(*newest);
+}
+
+inline Inode* Bin::remove(BinRecord& item) {
+    Inode* inode = item.inode;
+    // The path now maps to the previous record with the same path, if it is still in the bin
+    long long* newest = by_path.find(item.path);
+    if (newest != nullptr && *newest == item.seq) {
+        long long prev = item.prev_same;
+        if (prev >= head_seq && record(prev).live) { *newest = prev; }
+        else { by_path.erase(item.path); }
+    }
+    item.live = false;
+    item.inode = nullptr;
+    item.path = string();
+    live_count--;
+    live_bytes -= item.bytes;
+    drop_dead_front();
+    return inode;
+}
+
+inline void Bin::drop_dead_front() {
+    while (records.length() > 0 && !records.at(0).live) {
+        records.dequeue();
+        head_seq++;
+    }
+}
+
+#endif
@@ -0,0 +1,201 @@
+#include<iostream>
+#include<iomanip>
+#include<cstdlib>
+#include<cstring>
+#include<string>
+#include<cerrno>
+#include<chrono>
+#include<thread>
+#include<algorithm>
+#include<stdexcept>
+#include<unistd.h>
+#include<sys/socket.h>
+#include<sys/un.h>
+
+#include "vfs.hpp"
+#include "client.hpp"
+
+using namespace std;
+
+Client::Client(const string& socket_path) : fd(-1), offset(0) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket_path.length() >= sizeof(address.sun_path)) { throw runtime_error("Socket path is too long: " + socket_path); }
+    memcpy(address.sun_path, socket_path.c_str(), socket_path.length() + 1);
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        string reason = strerror(errno);
+        if (fd >= 0) { ::close(fd); }
+        throw runtime_error("Cannot connect to " + socket_path + ": " + reason);
+    }
+}
+
+Client::~Client() {
+    if (fd >= 0) { ::close(fd); }
+}
+
+void Client::send_all(const string& frames) {
+    size_t sent = 0;
+    while (sent < frames.length()) {
+        ssize_t count = send(fd, frames.data() + sent, frames.length() - sent, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR) { continue; }
+        if (count <= 0) { throw runtime_error("Connection to the server lost"); }
+        sent += count;
+    }
+}
+
+void Client::receive(uint32_t& id, int& status, string& payload) {
+    char buffer[64 * 1024];
+    while (true) {
+        //a whole frame is buffered: take it
+        size_t available = input.length() - offset;
+        if (available >= 4) {
+            uint32_t length = get_u32(input.data() + offset);
+            if (length < 5 || length > 5 + PROTOCOL_MAX_RESPONSE) { throw runtime_error("Malformed response from the server"); }
+            if (available - 4 >= length) {
+                const char* body = input.data() + offset + 4;
+                id = get_u32(body);
+                status = (unsigned char)body[4];
+                payload.assign(body + 5, length - 5);
+                offset += 4 + length;
+                //drop the parsed frames once they are a good part of the buffer
+                if (offset > input.length() / 2) {
+                    input.erase(0, offset);
+                    offset = 0;
+                }
+                return;
+            }
+        }
+        ssize_t count = read(fd, buffer, sizeof(buffer));
+        if (count < 0 && errno == EINTR) { continue; }
+        if (count <= 0) { throw runtime_error("Connection to the server lost"); }
+        input.append(buffer, count);
+    }
+}
+
+// Encodes a command line as a request, throws if the command is unknown
+static void encode_line(string& out, uint32_t id, const string& line) {
+    string command, parameter1, parameter2;
+    split_command(line, command, parameter1, parameter2);
+    int opcode = opcode_of(command);
+    if (opcode < 0) { throw runtime_error(command + ": command not found"); }
+    if (parameter1.length() > 0xFFFF || parameter2.length() > 0xFFFF) { throw runtime_error("Parameter too long"); }
+    encode_request(out, id, opcode, parameter1, parameter2);
+}
+
+int run_client(const string& socket_path) {
+    Client client(socket_path);
+    string line, frame, payload;
+    uint32_t id = 0;
+    while (getline(cin, line)) {
+        if (line.empty()) { continue; }
+        frame.clear();
+        try {
+            encode_line(frame, id++, line);
+        } catch (exception &e) {
+            cout << "Exception: " << e.what() << endl;
+            continue;
+        }
+        client.send_all(frame);
+        uint32_t answered;
+        int status;
+        client.receive(answered, status, payload);
+        if (status == STATUS_OK) { cout << payload; }
+        else { cout << "Exception: " << payload << endl; }
+        if (line == "exit") { break; }
+    }
+    return EXIT_SUCCESS;
+}
+
+//Load generator: every connection keeps depth requests in flight, sending the next one as soon as a response
+//comes back, until it sent its share of the requests. The commands are separated by ';' and sent in turn
+int run_load(const string& socket_path, int connections, int requests, int depth, const string& commands) {
+    if (connections < 1 || requests < 1 || depth < 1) { throw runtime_error("Connections, requests and depth must be positive"); }
+    //encode every command once, the requests only differ by their id which is patched in
+    Vector<string> frames;
+    size_t start = 0;
+    while (start <= commands.length()) {
+        size_t end = commands.find(';', start);
+        if (end == string::npos) { end = commands.length(); }
+        string line = commands.substr(start, end - start);
+        while (!line.empty() && line[0] == ' ') { line.erase(0, 1); }
+        if (!line.empty()) {
+            string frame;
+            encode_line(frame, 0, line);
+            frames.push_back(frame);
+        }
+        start = end + 1;
+    }
+    if (frames.empty()) { throw runtime_error("No command to send"); }
+
+    typedef chrono::steady_clock Clock;
+    int per_connection = (requests + connections - 1) / connections;
+    Vector<Vector<double> > latencies(connections);	//microseconds, one list per connection
+    for (int c = 0; c < connections; ++c) { latencies.push_back(Vector<double>(per_connection)); }
+    Vector<int> errors(connections);
+    for (int c = 0; c < connections; ++c) { errors.push_back(0); }
+    string failure;
+    mutex failure_lock;
+
+    Clock::time_point begin = Clock::now();
+    thread* workers = new thread[connections];
+    for (int c = 0; c < connections; ++c) {
+        workers[c] = thread([&, c]() {
+            try {
+                Client client(socket_path);
+                Vector<Clock::time_point> sent_at(per_connection);
+                for (int i = 0; i < per_connection; ++i) { sent_at.push_back(Clock::time_point()); }
+                int sent = 0, received = 0;
+                string batch, payload;
+                //send a request, with its id patched into the pre-encoded frame
+                auto queue = [&]() {
+                    size_t at = batch.length();
+                    batch += frames[(c + sent) % frames.size()];
+                    uint32_t id = sent;
+                    memcpy(&batch[at + 4], &id, 4);
+                    sent_at[sent++] = Clock::now();
+                };
+                while (sent < per_connection && sent < depth) { queue(); }
+                client.send_all(batch);
+                while (received < per_connection) {
+                    uint32_t id;
+                    int status;
+                    client.receive(id, status, payload);
+                    latencies[c].push_back(chrono::duration<double, micro>(Clock::now() - sent_at[id]).count());
+                    if (status != STATUS_OK) { errors[c]++; }
+                    received++;
+                    if (sent < per_connection) {
+                        batch.clear();
+                        queue();
+                        client.send_all(batch);
+                    }
+                }
+            } catch (exception &e) {
+                lock_guard<mutex> guard(failure_lock);
+                failure = e.what();
+            }
+        });
+    }
+    for (int c = 0; c < connections; ++c) { workers[c].join(); }
+    delete[] workers;
+    double seconds = chrono::duration<double>(Clock::now() - begin).count();
+    if (!failure.empty()) { throw runtime_error(failure); }
+
+    //merge the latencies and report
+    Vector<double> all(connections * per_connection);
+    int error_count = 0;
+    for (int c = 0; c < connections; ++c) {
+        for (int i = 0; i < latencies[c].size(); ++i) { all.push_back(latencies[c][i]); }
+        error_count += errors[c];
+    }
+    sort(all.data(), all.data() + all.size());
+    int total = all.size();
+    cout << total << " requests on " << connections << " connection(s), " << depth << " in flight each, in "
+         << fixed << setprecision(3) << seconds << " s" << endl;
+    cout << setprecision(0) << total / seconds << " ops/s" << endl;
+    cout << setprecision(1) << "latency us: p50 " << all[total / 2] << ", p99 " << all[min(total - 1, (int)(total * 0.99))]
+         << ", max " << all[total - 1] << endl;
+    if (error_count > 0) { cout << error_count << " request(s) answered with an error" << endl; }
+    return EXIT_SUCCESS;
+}
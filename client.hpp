@@ -0,0 +1,31 @@
+#ifndef CLIENT_H
+#define CLIENT_H
+#include<cstdlib>
+#include<string>
+#include<stdint.h>
+#include "protocol.hpp"
+
+using namespace std;
+
+//Blocking connection to a server started with --serve
+class Client
+{
+	private:
+		int fd;							//socket connected to the server
+		string input;					//bytes received and not parsed yet
+		size_t offset;					//start of the first unparsed frame in input
+
+	public:
+		Client(const string& socket_path);
+		~Client();
+		Client(const Client&) = delete;
+		Client& operator=(const Client&) = delete;
+
+		void send_all(const string& frames);	//Send one or more encoded requests
+		void receive(uint32_t& id, int& status, string& payload);	//Wait for the next response
+};
+
+int run_client(const string& socket_path);	//Send the commands read from stdin one by one and print the answers
+int run_load(const string& socket_path, int connections, int requests, int depth, const string& commands);	//Load generator
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include<string>
+using namespace std;
+
+//Commands of the VFS, in the order of their opcodes in the protocol. New commands go at the end so that
+//the opcodes of the others stay the same. VFS::execute dispatches on the same list, a command it runs
+//is always one the clients can send
+enum Opcode {
+	OP_HELP, OP_PWD, OP_LS, OP_MKDIR, OP_TOUCH, OP_CD, OP_RM, OP_SIZE, OP_SHOWBIN, OP_EMPTYBIN, OP_BINLIMIT,
+	OP_EXIT, OP_FIND, OP_MV, OP_RECOVER, OP_STATS, OP_EXPORT, OP_THREADS, OP_BENCH, OP_CHECKPOINT, OP_JOURNAL,
+	OP_SNAPSHOT, OP_IMPORT, OP_CP, OP_CHECK, OP_COUNT
+};
+
+//How a command uses the tree, which decides the lock it runs under
+enum CommandKind {
+	COMMAND_READ,		//only reads the tree, runs alongside the other readers
+	COMMAND_CHANGE,		//changes the tree, refused in the folders of a snapshot
+	COMMAND_CONTROL		//changes the bin, the settings or the files, or needs the tree to itself
+};
+
+struct CommandInfo
+{
+	const char* name;	//name of the command, as typed
+	int kind;			//CommandKind
+};
+
+static const CommandInfo COMMANDS[OP_COUNT] = {
+	{ "help", COMMAND_READ }, { "pwd", COMMAND_READ }, { "ls", COMMAND_READ }, { "mkdir", COMMAND_CHANGE },
+	{ "touch", COMMAND_CHANGE }, { "cd", COMMAND_READ }, { "rm", COMMAND_CHANGE }, { "size", COMMAND_READ },
+	{ "showbin", COMMAND_READ }, { "emptybin", COMMAND_CONTROL }, { "binlimit", COMMAND_CONTROL },
+	{ "exit", COMMAND_CONTROL }, { "find", COMMAND_READ }, { "mv", COMMAND_CHANGE }, { "recover", COMMAND_CHANGE },
+	{ "stats", COMMAND_READ }, { "export", COMMAND_READ }, { "threads", COMMAND_CONTROL }, { "bench", COMMAND_CONTROL },
+	{ "checkpoint", COMMAND_CONTROL }, { "journal", COMMAND_CONTROL }, { "snapshot", COMMAND_CONTROL },
+	{ "import", COMMAND_CHANGE }, { "cp", COMMAND_CHANGE }, { "check", COMMAND_CONTROL }
+};
+
+// Opcode of a command name, -1 if there is none
+inline int opcode_of(const string& command) {
+    for (int i = 0; i < OP_COUNT; ++i) {
+        if (command == COMMANDS[i].name) { return i; }
+    }
+    return -1;
+}
+
+#endif
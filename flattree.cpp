@@ -0,0 +1,76 @@
+#include<cstdlib>
+#include<string>
+
+#include "vfs.hpp"
+#include "flattree.hpp"
+#include "trie.hpp"
+
+using namespace std;
+
+void FlatTree::clear() {
+    parent.clear();
+    size.clear();
+    total.clear();
+    name.clear();
+    node.clear();
+    built = false;
+}
+
+void FlatTree::reserve(int capacity) {
+    parent.reserve(capacity);
+    size.reserve(capacity);
+    total.reserve(capacity);
+    name.reserve(capacity);
+    node.reserve(capacity);
+}
+
+void FlatTree::add(Inode* inode, uint32_t parent_index, uint32_t own, unsigned long long cached, Name interned) {
+    parent.push_back(parent_index);
+    size.push_back(own);
+    total.push_back(cached);
+    name.push_back(interned);
+    node.push_back(inode);
+}
+
+unsigned long long FlatTree::recount(int* mismatches) {
+    int n = count();
+    const uint32_t* own = size.data();
+    unsigned long long bytes = 0;
+    for (int i = 0; i < n; ++i) { bytes += own[i]; }
+    if (mismatches == nullptr) { return bytes; }
+
+    //the cached total of an Inode must be its own size plus the cached totals of its children
+    const uint32_t* up = parent.data();
+    const unsigned long long* cached = total.data();
+    Vector<unsigned long long> expected(n);
+    for (int i = 0; i < n; ++i) { expected.push_back(own[i]); }
+    unsigned long long* sum = expected.data();
+    for (int i = 1; i < n; ++i) { sum[up[i]] += cached[i]; }
+    for (int i = 0; i < n; ++i) {
+        if (sum[i] != cached[i]) { (*mismatches)++; }
+    }
+    return bytes;
+}
+
+void FlatTree::find(Name interned, Vector<Inode*>& hits) {
+    int n = count();
+    const Name* names = name.data();
+    for (int i = 0; i < n; ++i) {
+        if (names[i] == interned) { hits.push_back(node[i]); }
+    }
+}
+
+void FlatTree::find_glob(const string& pattern, Vector<Inode*>& hits) {
+    int n = count();
+    const Name* names = name.data();
+    GlobFilter filter(pattern);
+    for (int i = 0; i < n; ++i) {
+        if (filter.match(names[i].data(), names[i].length())) { hits.push_back(node[i]); }
+    }
+}
+
+size_t FlatTree::bytes() const {
+    return (size_t)parent.capacity() * sizeof(uint32_t) + (size_t)size.capacity() * sizeof(uint32_t)
+           + (size_t)total.capacity() * sizeof(unsigned long long) + (size_t)name.capacity() * sizeof(Name)
+           + (size_t)node.capacity() * sizeof(Inode*);
+}
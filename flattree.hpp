@@ -0,0 +1,40 @@
+#ifndef FLATTREE_H
+#define FLATTREE_H
+#include<cstdlib>
+#include<string>
+#include<stdint.h>
+#include "vector.hpp"
+#include "pool.hpp"
+
+using namespace std;
+
+#define FLAT_NONE 0xFFFFFFFFu			//parent index of the root
+
+class Inode;
+
+//Structure-of-arrays copy of the tree for the whole-tree scans: the Inodes in pre-order with their hot
+//fields in parallel arrays, so a recount is a sum over one array and finding a name compares interned
+//pointers, without following a pointer and missing the cache for every Inode. The VFS fills it on the
+//first scan after the tree changed and keeps it until the next change
+struct FlatTree
+{
+	Vector<uint32_t> parent;				//index of the parent, FLAT_NONE for the root
+	Vector<uint32_t> size;					//own size
+	Vector<unsigned long long> total;		//cached total of the subtree when the copy was made
+	Vector<Name> name;						//interned name
+	Vector<Inode*> node;					//the Inode itself, only followed for the hits
+	unsigned long long version;				//version of the tree that was copied
+	bool built;								//false until the first copy
+
+	FlatTree() : version(0), built(false) {}
+	int count() const { return node.size(); }
+	void clear();
+	void reserve(int capacity);
+	void add(Inode* inode, uint32_t parent_index, uint32_t own, unsigned long long cached, Name interned);
+	unsigned long long recount(int* mismatches);				//Sum of the own sizes, totals that don't add up are counted in mismatches
+	void find(Name interned, Vector<Inode*>& hits);				//Inodes with this name
+	void find_glob(const string& pattern, Vector<Inode*>& hits);	//Inodes whose name matches a pattern
+	size_t bytes() const;									//Heap memory of the arrays
+};
+
+#endif
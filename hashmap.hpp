@@ -0,0 +1,140 @@
+#ifndef HASHMAP_H
+#define HASHMAP_H
+
+#include<cstdlib>
+#include<string>
+#include<stdint.h>
+#include "pool.hpp"
+using namespace std;
+
+//Hash functions used by HashMap
+inline unsigned int hash_key(const string& key) { return hash_name(key.data(), key.length()); }
+inline unsigned int hash_key(const Name& key) { return (unsigned int)((reinterpret_cast<uintptr_t>(key.data()) >> 3) * 2654435761u); }
+inline unsigned int hash_key(const void* key) { return (unsigned int)((reinterpret_cast<uintptr_t>(key) >> 3) * 2654435761u); }
+inline unsigned int hash_key(long long key) { return (unsigned int)(((unsigned long long)key * 11400714819323198485ull) >> 32); }
+
+//Hash map with open addressing and linear probing. Erased entries leave tombstones that are
+//dropped the next time the table is rebuilt. K and V must be default constructible.
+template <typename K, typename V>
+class HashMap
+{
+	private:
+		enum { EMPTY = 0, USED = 1, ERASED = 2 };
+		struct Slot {
+			unsigned char state;	//EMPTY, USED or ERASED
+			unsigned int hash;		//cached hash of the key
+			K key;
+			V value;
+		};
+		Slot* slots;				//table of slots, capacity is always a power of two
+		int capacity;				//number of slots
+		int count;					//number of entries
+		int used;					//entries + tombstones
+		void rehash(int new_capacity);
+
+	public:
+		HashMap() : slots(nullptr), capacity(0), count(0), used(0) {}
+		~HashMap() { delete[] slots; }
+		HashMap(const HashMap&) = delete;
+		HashMap& operator=(const HashMap&) = delete;
+
+		V* find(const K& key);				//Returns the value of a key, nullptr if it is not in the map
+		V& operator[](const K& key);		//Returns the value of a key, adding a default value if needed
+		bool erase(const K& key);			//Removes a key, returns false if it was not in the map
+		void clear();						//Removes all the entries
+		template <typename F> void for_each(F visit);	//Calls visit(key, value) for every entry
+		int size() const { return count; }
+};
+
+template <typename K, typename V>
+V* HashMap<K, V>::find(const K& key) {
+    if (count == 0) { return nullptr; }
+    unsigned int h = hash_key(key);
+    int mask = capacity - 1;
+    for (int i = h & mask; slots[i].state != EMPTY; i = (i + 1) & mask) {
+        if (slots[i].state == USED && slots[i].hash == h && slots[i].key == key) {
+            return &slots[i].value;
+        }
+    }
+    return nullptr;
+}
+
+template <typename K, typename V>
+V& HashMap<K, V>::operator[](const K& key) {
+    V* found = find(key);
+    if (found != nullptr) { return *found; }
+    // Keep the table at most half full, counting the tombstones
+    if ((used + 1) * 2 > capacity) {
+        rehash(capacity == 0 ? 16 : ((count + 1) * 4 > capacity ? capacity * 2 : capacity));
+    }
+    unsigned int h = hash_key(key);
+    int mask = capacity - 1;
+    int i = h & mask;
+    while (slots[i].state == USED) { i = (i + 1) & mask; }
+    if (slots[i].state == EMPTY) { used++; }
+    slots[i].state = USED;
+    slots[i].hash = h;
+    slots[i].key = key;
+    slots[i].value = V();
+    count++;
+    return slots[i].value;
+}
+
+template <typename K, typename V>
+bool HashMap<K, V>::erase(const K& key) {
+    if (count == 0) { return false; }
+    unsigned int h = hash_key(key);
+    int mask = capacity - 1;
+    for (int i = h & mask; slots[i].state != EMPTY; i = (i + 1) & mask) {
+        if (slots[i].state == USED && slots[i].hash == h && slots[i].key == key) {
+            slots[i].state = ERASED;
+            // Release what the key and value hold right away
+            slots[i].key = K();
+            slots[i].value = V();
+            count--;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename K, typename V>
+void HashMap<K, V>::clear() {
+    delete[] slots;
+    slots = nullptr;
+    capacity = 0;
+    count = 0;
+    used = 0;
+}
+
+template <typename K, typename V>
+template <typename F>
+void HashMap<K, V>::for_each(F visit) {
+    for (int i = 0; i < capacity; ++i) {
+        if (slots[i].state == USED) { visit(slots[i].key, slots[i].value); }
+    }
+}
+
+// Rebuilds the table with the given capacity, dropping all tombstones.
+template <typename K, typename V>
+void HashMap<K, V>::rehash(int new_capacity) {
+    Slot* old_slots = slots;
+    int old_capacity = capacity;
+    slots = new Slot[new_capacity];
+    for (int i = 0; i < new_capacity; ++i) { slots[i].state = EMPTY; }
+    capacity = new_capacity;
+    used = count;
+    int mask = capacity - 1;
+    for (int j = 0; j < old_capacity; ++j) {
+        if (old_slots[j].state != USED) { continue; }
+        int i = old_slots[j].hash & mask;
+        while (slots[i].state != EMPTY) { i = (i + 1) & mask; }
+        slots[i].state = USED;
+        slots[i].hash = old_slots[j].hash;
+        slots[i].key = std::move(old_slots[j].key);
+        slots[i].value = std::move(old_slots[j].value);
+    }
+    delete[] old_slots;
+}
+
+#endif
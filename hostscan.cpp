@@ -0,0 +1,139 @@
+#include<cstdlib>
+#include<cstring>
+#include<string>
+#include<cerrno>
+#include<thread>
+#include<chrono>
+#include<stdexcept>
+#include<fcntl.h>
+#include<unistd.h>
+#include<dirent.h>
+#include<sys/stat.h>
+#include<sys/syscall.h>
+
+#include "vfs.hpp"
+#include "hostscan.hpp"
+
+using namespace std;
+
+//Record returned by getdents64, which glibc doesn't declare
+struct linux_dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+HostScan::HostScan() : root_fd(-1), active(0), entry_count(0), other_count(0), scan_seconds(0) {}
+
+HostScan::~HostScan() {
+    for (int i = 0; i < results.size(); ++i) { delete results[i]; }
+    if (root_fd >= 0) { close(root_fd); }
+}
+
+void HostScan::scan(const string& path, int threads) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    root_fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd < 0) { throw runtime_error("Cannot open the host folder " + path + ": " + strerror(errno)); }
+    HostListing* top = new HostListing();
+    top->readable = false;
+    results.push_back(top);
+    queue.push_back(0);
+    if (threads < HOST_SCAN_MIN_THREADS) { threads = HOST_SCAN_MIN_THREADS; }
+    //the calling thread is one of them
+    Vector<thread> pool;
+    for (int i = 1; i < threads; ++i) { pool.push_back(thread(&HostScan::work, this)); }
+    work();
+    for (int i = 0; i < pool.size(); ++i) { pool[i].join(); }
+    scan_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (!top->readable) { throw runtime_error("Cannot read the host folder " + path); }
+}
+
+int HostScan::unreadable() {
+    int count = 0;
+    for (int i = 0; i < results.size(); ++i) {
+        if (!results[i]->readable) { count++; }
+    }
+    return count;
+}
+
+void HostScan::work() {
+    char* buffer = new char[HOST_SCAN_BUFFER];
+    Vector<HostListing*> found;
+    unsigned long long entries = 0, others = 0;
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        while (queue.empty() && active > 0) { ready.wait(guard); }
+        //nothing queued and nobody reading a folder that could queue more
+        if (queue.empty()) { break; }
+        HostListing& listing = *results[queue.back()];
+        queue.pop_back();
+        active++;
+        guard.unlock();
+        found.clear();
+        read_folder(listing, buffer, found, others);
+        entries += listing.entries.size();
+        guard.lock();
+        //number the subfolders and hand them to the other threads
+        int first = results.size();
+        for (int i = 0, f = 0; i < listing.entries.size(); ++i) {
+            if (!listing.entries[i].folder) { continue; }
+            listing.entries[i].listing = first + f;
+            results.push_back(found[f]);
+            queue.push_back(first + f);
+            f++;
+        }
+        active--;
+        if (!queue.empty() || active == 0) { ready.notify_all(); }
+    }
+    entry_count += entries;
+    other_count += others;
+    guard.unlock();
+    delete[] buffer;
+}
+
+//Reads the entries of a folder, and makes an empty listing for each of its subfolders in found, in order
+void HostScan::read_folder(HostListing& listing, char* buffer, Vector<HostListing*>& found, unsigned long long& others) {
+    int fd = openat(root_fd, listing.path.empty() ? "." : listing.path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) { return; }
+    listing.readable = true;
+    while (true) {
+        long count = syscall(SYS_getdents64, fd, buffer, HOST_SCAN_BUFFER);
+        if (count < 0 && errno == EINTR) { continue; }
+        if (count < 0) { listing.readable = false; }
+        if (count <= 0) { break; }
+        for (long offset = 0; offset < count; ) {
+            linux_dirent64* record = reinterpret_cast<linux_dirent64*>(buffer + offset);
+            offset += record->d_reclen;
+            const char* name = record->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) { continue; }
+            //the type is usually in the record, only the sizes and the times need a stat
+            unsigned char type = record->d_type;
+            if (type != DT_DIR && type != DT_REG && type != DT_UNKNOWN) { others++; continue; }
+            struct stat info;
+            if (fstatat(fd, name, &info, AT_SYMLINK_NOFOLLOW) != 0 || (!S_ISDIR(info.st_mode) && !S_ISREG(info.st_mode))) {
+                others++;
+                continue;
+            }
+            HostEntry entry;
+            size_t length = strlen(name);
+            entry.name = listing.names.length();
+            entry.length = (uint16_t)length;
+            entry.folder = S_ISDIR(info.st_mode);
+            entry.listing = -1;
+            entry.size = entry.folder ? 0 : (unsigned long long)info.st_size;
+            entry.modified = (int64_t)info.st_mtim.tv_sec * 1000000 + info.st_mtim.tv_nsec / 1000;
+            listing.names.append(name, length);
+            listing.entries.push_back(entry);
+            if (entry.folder) {
+                HostListing* sub = new HostListing();
+                sub->path = listing.path.empty() ? string(name, length) : listing.path + "/" + string(name, length);
+                sub->readable = false;
+                found.push_back(sub);
+            }
+        }
+    }
+    close(fd);
+}
@@ -0,0 +1,69 @@
+#ifndef HOSTSCAN_H
+#define HOSTSCAN_H
+#include<cstdlib>
+#include<string>
+#include<stdint.h>
+#include<mutex>
+#include<condition_variable>
+#include "vector.hpp"
+
+using namespace std;
+
+#define HOST_SCAN_BUFFER (64 << 10)		//bytes of directory entries read by one getdents64 call
+#define HOST_SCAN_MIN_THREADS 4			//the scan mostly waits for the disk, so it uses at least this many threads
+
+//Entry of a host folder: a regular file or a folder, symbolic links and devices are left out
+struct HostEntry
+{
+	uint32_t name;					//offset of the name in the names of the listing
+	uint16_t length;				//length of the name
+	bool folder;					//true for a folder
+	int listing;					//listing of the entries of a folder, -1 for a file
+	unsigned long long size;		//size of a file
+	int64_t modified;				//time of the last change, in microseconds since the epoch
+};
+
+//Entries of one host folder, with their names packed one after the other
+struct HostListing
+{
+	string path;					//path of the folder relative to the scanned one, empty for the scanned one
+	string names;					//names of the entries
+	Vector<HostEntry> entries;
+	bool readable;					//false if the folder could not be opened or read
+};
+
+//Parallel scan of a host directory tree. Each folder is read with openat and getdents64 by one of the
+//threads, which stats its entries relative to the open folder and queues its subfolders for the others.
+//Listing 0 is the scanned folder itself; a folder entry points at the listing of its own entries
+class HostScan
+{
+	private:
+		int root_fd;						//the scanned folder, -1 when closed
+		Vector<HostListing*> results;		//every listing, by number
+		Vector<int> queue;					//listings waiting to be read
+		int active;							//threads reading a folder
+		mutex lock;							//guards results, queue and active
+		condition_variable ready;			//wakes the threads when folders are queued or the scan is over
+		unsigned long long entry_count;		//files and folders found
+		unsigned long long other_count;		//entries left out (links, devices, sockets...)
+		double scan_seconds;				//time the scan took
+
+		void work();						//Body of the threads: read queued folders until none is left
+		void read_folder(HostListing& listing, char* buffer, Vector<HostListing*>& found, unsigned long long& others);
+
+	public:
+		HostScan();
+		~HostScan();
+		HostScan(const HostScan&) = delete;
+		HostScan& operator=(const HostScan&) = delete;
+
+		void scan(const string& path, int threads);		//Read the whole tree under path, throws if path is not a readable folder
+		int listings() const { return results.size(); }
+		const HostListing& listing(int i) { return *results[i]; }
+		unsigned long long entries() const { return entry_count; }
+		unsigned long long others() const { return other_count; }
+		int unreadable();								//Folders that could not be read
+		double seconds() const { return scan_seconds; }
+};
+
+#endif
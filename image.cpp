@@ -0,0 +1,101 @@
+#include<cstdlib>
+#include<cstring>
+#include<cstddef>
+#include<string>
+#include<stdexcept>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+
+#include "image.hpp"
+
+using namespace std;
+
+Image::Image() : fd(-1), base(nullptr), length(0), header(nullptr), records(nullptr), strings(nullptr), bin(nullptr) {}
+
+Image::~Image() {
+    close();
+}
+
+bool Image::open(const string& filename) {
+    close();
+    fd = ::open(filename.c_str(), O_RDONLY);
+    //no image saved yet
+    if (fd < 0) { return false; }
+
+    //a version 1 header ends before the checkpoint
+    const size_t v1_header = offsetof(ImageHeader, checkpoint);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < v1_header) {
+        close();
+        throw runtime_error(filename + " is not a VFS image");
+    }
+    length = st.st_size;
+    //map the whole file, records and names are read in place
+    void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        close();
+        throw runtime_error("Cannot map " + filename);
+    }
+    base = static_cast<char*>(mapping);
+    header = reinterpret_cast<const ImageHeader*>(base);
+
+    //check that the header matches this build and that the tables fit in the file
+    bool known = memcmp(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) == 0
+                 && (header->version == 1 || (header->version >= 2 && header->version <= IMAGE_VERSION && length >= sizeof(ImageHeader)));
+    size_t header_size = (known && header->version == 1) ? v1_header : sizeof(ImageHeader);
+    if (!known || header->record_size != sizeof(ImageRecord) || header->count == 0 || header->count >= IMAGE_NONE
+        || header->count * sizeof(ImageRecord) > length - header_size
+        || header->strings_offset < header_size + header->count * sizeof(ImageRecord)
+        || header->strings_offset > length || header->strings_size > length - header->strings_offset
+        || (header->version >= 2 && (header->bin_count >= IMAGE_NONE || header->bin_offset > length
+            || header->bin_count * sizeof(ImageBinItem) > length - header->bin_offset))) {
+        close();
+        throw runtime_error(filename + " is not a valid VFS image");
+    }
+    records = reinterpret_cast<const ImageRecord*>(base + header_size);
+    strings = base + header->strings_offset;
+    if (header->version >= 2) { bin = reinterpret_cast<const ImageBinItem*>(base + header->bin_offset); }
+    return true;
+}
+
+void Image::close() {
+    if (base != nullptr) { munmap(base, length); }
+    if (fd >= 0) { ::close(fd); }
+    fd = -1;
+    base = nullptr;
+    length = 0;
+    header = nullptr;
+    records = nullptr;
+    strings = nullptr;
+    bin = nullptr;
+}
+
+const ImageRecord& Image::record(uint32_t index) const {
+    if (index >= header->count) { throw runtime_error("Corrupt VFS image: record index out of range"); }
+    const ImageRecord& r = records[index];
+    //the strings of a record must lie inside the string table
+    if ((uint64_t)r.name_offset + r.name_length > header->strings_size
+        || (uint64_t)r.date_offset + r.date_length > header->strings_size) {
+        throw runtime_error("Corrupt VFS image: string out of range");
+    }
+    return r;
+}
+
+const ImageBinItem& Image::bin_item(uint32_t index) const {
+    if (index >= bin_count()) { throw runtime_error("Corrupt VFS image: bin item out of range"); }
+    const ImageBinItem& item = bin[index];
+    if (item.record >= header->count || (item.parent != IMAGE_NONE && item.parent >= header->count)
+        || (uint64_t)item.path_offset + item.path_length > header->strings_size) {
+        throw runtime_error("Corrupt VFS image: wrong bin item");
+    }
+    return item;
+}
+
+bool Image::bin_limits(uint64_t& items, uint64_t& bytes) const {
+    if (bin == nullptr) { return false; }
+    items = header->bin_max_items;
+    bytes = header->bin_max_bytes;
+    return true;
+}
@@ -0,0 +1,90 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+#include<cstdlib>
+#include<cstring>
+#include<string>
+#include<stdint.h>
+#include<stdexcept>
+
+using namespace std;
+
+#define IMAGE_MAGIC "VFSIMG1"
+#define IMAGE_VERSION 3					//version 1 images have neither the checkpoint nor the bin, versions 1 and 2 store dates as text
+#define IMAGE_NONE 0xFFFFFFFFu			//index used when there is no parent/child/sibling
+
+//Binary image of a VFS: the header, then one fixed-size record per Inode, then a single string table,
+//then the table of the items of the bin. Records are stored in breadth-first order, so the children of an
+//Inode are consecutive records. The root is record 0, the roots of the items of the bin follow it.
+struct ImageHeader
+{
+	char magic[8];					//IMAGE_MAGIC
+	uint32_t version;				//IMAGE_VERSION
+	uint32_t record_size;			//sizeof(ImageRecord) of the writer
+	uint64_t count;					//number of records, record 0 is the root
+	uint64_t strings_offset;		//file offset of the string table
+	uint64_t strings_size;			//size of the string table in bytes
+	uint64_t checkpoint;			//checkpoint of the image, the journal of the same checkpoint follows it
+	uint64_t bin_count;				//number of items in the bin table
+	uint64_t bin_offset;			//file offset of the bin table
+	uint64_t bin_max_items;			//limits of the bin, 0 for no limit
+	uint64_t bin_max_bytes;
+};
+
+//An item of the bin, oldest first
+struct ImageBinItem
+{
+	uint32_t record;				//root record of the removed subtree
+	uint32_t parent;				//record of the folder it was removed from, IMAGE_NONE if it is gone
+	uint32_t path_offset;			//offset of the path it was removed from in the string table
+	uint32_t path_length;			//length of the path
+};
+
+struct ImageRecord
+{
+	uint64_t total;					//total size of the subtree
+	uint32_t size;					//own size of the Inode
+	uint32_t parent;				//index of the parent record
+	uint32_t first_child;			//index of the first child record
+	uint32_t next_sibling;			//index of the next sibling record
+	uint32_t child_count;			//number of children
+	uint32_t name_offset;			//offset of the name in the string table
+	uint32_t date_offset;			//offset of the creation time in the string table (microseconds as 8 bytes since version 3)
+	uint16_t name_length;			//length of the name
+	uint8_t date_length;			//length of the creation time
+	uint8_t type;					//File or Folder
+};
+
+//Read-only view of an image file mapped in memory
+class Image
+{
+	private:
+		int fd;						//file descriptor of the mapped file
+		char* base;					//start of the mapping
+		size_t length;				//length of the mapping
+		const ImageHeader* header;	//header at the start of the mapping
+		const ImageRecord* records;	//record table
+		const char* strings;		//string table
+		const ImageBinItem* bin;	//bin table, nullptr in a version 1 image
+
+	public:
+		Image();
+		~Image();
+		Image(const Image&) = delete;
+		Image& operator=(const Image&) = delete;
+
+		bool open(const string& filename);				//Map a file, false if it doesn't exist. Throws if it is not a valid image
+		void close();									//Unmap the file
+		bool is_open() const { return base != nullptr; }
+		uint32_t version() const { return header->version; }
+		uint32_t count() const { return (uint32_t)header->count; }
+		const ImageRecord& record(uint32_t index) const;	//Returns a record, throws if the index is out of range
+		const char* name(const ImageRecord& record) const { return strings + record.name_offset; }
+		const char* date(const ImageRecord& record) const { return strings + record.date_offset; }
+		uint64_t checkpoint() const { return bin != nullptr ? header->checkpoint : 0; }
+		uint32_t bin_count() const { return bin != nullptr ? (uint32_t)header->bin_count : 0; }
+		const ImageBinItem& bin_item(uint32_t index) const;	//Returns an item of the bin, throws if it is out of range
+		const char* path(const ImageBinItem& item) const { return strings + item.path_offset; }
+		bool bin_limits(uint64_t& items, uint64_t& bytes) const;	//Limits of the bin, false in a version 1 image
+};
+
+#endif
@@ -1,36 +1,168 @@
 #ifndef INODE_H
 #define INODE_H
 #include<cstdlib>
+#include<cstring>
 #include<string>
 #include<ctime>
+#include<stdint.h>
+#include<atomic>
 #include "vector.hpp"
+#include "pool.hpp"
 
 using namespace std;
 enum {File=0,Folder=1};
 
+class Inode;
+
+//Hash index over the children of a folder, keyed on the child name (open addressing, linear probing)
+class ChildIndex
+{
+	private:
+		struct Slot {
+			unsigned int hash;		//cached hash of the child name
+			Inode* node;			//child stored in this slot, nullptr if empty
+		};
+		Slot* slots;				//table of slots, capacity is always a power of two
+		int capacity;				//number of slots
+		int count;					//number of live children in the table
+		int used;					//live children + tombstones
+		void rehash(int new_capacity);
+
+	public:
+		ChildIndex() : slots(nullptr), capacity(0), count(0), used(0) {}
+		~ChildIndex() { delete[] slots; }
+		ChildIndex(const ChildIndex&) = delete;
+		ChildIndex& operator=(const ChildIndex&) = delete;
+
+		Inode* find(const char* name, size_t length) const;	//Return the child with this name, nullptr if not found
+		Inode* find(const string& name) const { return find(name.data(), name.length()); }
+		void insert(Inode* node);							//Add a child (its name must not be in the table)
+		void erase(Inode* node);							//Remove a child
+		void reserve(int more);								//Size the table once for more children
+		int size() const { return count; }
+		size_t bytes() const { return capacity * sizeof(Slot); }	//Heap memory used by the table
+
+		static unsigned int hash(const char* name, size_t length);
+};
+
 class Inode
 {
 	private:
-		string name;				//name of the Inode
+		Name name;					//name of the Inode, interned in the string pool of the VFS
 		bool type;					//type of the Inode 0 for File 1 for Folder
 		unsigned int size;			//size of current Inode
-		string cr_time; 			//time of creation
+		unsigned long long total;	//cached size of the whole subtree (own size + all descendants)
+		int64_t created;			//time of creation, in microseconds since the epoch
 		Vector<Inode*> children;	//Children of Inode
-		Inode* parent; 				//link to the parent 
+		ChildIndex index;			//hash index of the children by name
+		Inode* parent; 				//link to the parent
+		atomic<int> image_record;	//record of a folder whose children are still only in the mapped image, -1 otherwise
+		int name_slot;				//position of the Inode in the list of Inodes with the same name (name index of the VFS)
+		int child_slot;				//position of the Inode in the children of its parent
+		unsigned int frozen_at;		//id of the latest snapshot that kept the total and the parent of the Inode
+		unsigned int children_frozen_at;	//id of the latest snapshot that kept the children
 
 	public:
 		Inode() {}
 
-		Inode(string i_name, Inode* i_parent, bool i_type, int i_size, string i_cr_time) //: name(name),type(type),size(size),cr_time(cr_time),parent(parent)
-		{ 	
+		Inode(Name i_name, Inode* i_parent, bool i_type, int i_size, int64_t i_created) //: name(name),type(type),size(size),created(created),parent(parent)
+		{
 			name = i_name;
 			type = i_type;
 			size = i_size;
-			cr_time = i_cr_time;
+			total = i_size;
+			created = i_created;
 			parent = i_parent;
+			image_record = -1;
+			name_slot = -1;
+			child_slot = -1;
+			frozen_at = 0;
+			children_frozen_at = 0;
 		}
-		
+
 		friend class VFS;
+		friend class ChildIndex;
 };
 
-#endif
\ No newline at end of file
+//marker left in a slot whose child was erased, so that probing continues past it
+#define CHILD_TOMBSTONE (reinterpret_cast<Inode*>(1))
+
+inline unsigned int ChildIndex::hash(const char* name, size_t length) {
+    return hash_name(name, length);
+}
+
+// Looks up a child by name, probing from its home slot until an empty slot is met.
+inline Inode* ChildIndex::find(const char* name, size_t length) const {
+    if (count == 0) { return nullptr; }
+    unsigned int h = hash(name, length);
+    int mask = capacity - 1;
+    for (int i = h & mask; ; i = (i + 1) & mask) {
+        Inode* node = slots[i].node;
+        if (node == nullptr) { return nullptr; }
+        // Compare the cached hash first so that most mismatches never touch the string
+        if (node != CHILD_TOMBSTONE && slots[i].hash == h && node->name.length() == length
+            && names_equal(node->name.data(), name, length)) {
+            return node;
+        }
+    }
+}
+
+// Adds a child, growing the table when it gets more than half full.
+inline void ChildIndex::insert(Inode* node) {
+    if ((used + 1) * 2 > capacity) {
+        // Grow only if the live children need it, otherwise rebuilding drops the tombstones
+        rehash(capacity == 0 ? 8 : ((count + 1) * 4 > capacity ? capacity * 2 : capacity));
+    }
+    unsigned int h = hash(node->name.data(), node->name.length());
+    int mask = capacity - 1;
+    int i = h & mask;
+    while (slots[i].node != nullptr && slots[i].node != CHILD_TOMBSTONE) {
+        i = (i + 1) & mask;
+    }
+    if (slots[i].node == nullptr) { used++; }
+    slots[i].hash = h;
+    slots[i].node = node;
+    count++;
+}
+
+// Removes a child, leaving a tombstone in its slot.
+inline void ChildIndex::erase(Inode* node) {
+    if (count == 0) { return; }
+    unsigned int h = hash(node->name.data(), node->name.length());
+    int mask = capacity - 1;
+    for (int i = h & mask; slots[i].node != nullptr; i = (i + 1) & mask) {
+        if (slots[i].node == node) {
+            slots[i].node = CHILD_TOMBSTONE;
+            count--;
+            return;
+        }
+    }
+}
+
+// Grows the table so that the next inserts never rehash.
+inline void ChildIndex::reserve(int more) {
+    int needed = 8;
+    while (needed < (count + more) * 2) { needed *= 2; }
+    if (needed > capacity) { rehash(needed); }
+}
+
+// Rebuilds the table with the given capacity, dropping all tombstones.
+inline void ChildIndex::rehash(int new_capacity) {
+    Slot* old_slots = slots;
+    int old_capacity = capacity;
+    slots = new Slot[new_capacity];
+    for (int i = 0; i < new_capacity; ++i) { slots[i].node = nullptr; }
+    capacity = new_capacity;
+    used = count;
+    int mask = capacity - 1;
+    for (int j = 0; j < old_capacity; ++j) {
+        Inode* node = old_slots[j].node;
+        if (node == nullptr || node == CHILD_TOMBSTONE) { continue; }
+        int i = old_slots[j].hash & mask;
+        while (slots[i].node != nullptr) { i = (i + 1) & mask; }
+        slots[i] = old_slots[j];
+    }
+    delete[] old_slots;
+}
+
+#endif
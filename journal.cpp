@@ -0,0 +1,253 @@
+#include<cstdlib>
+#include<cstring>
+#include<string>
+#include<cerrno>
+#include<chrono>
+#include<stdexcept>
+#include<fcntl.h>
+#include<unistd.h>
+
+#include "journal.hpp"
+
+using namespace std;
+
+#define JOURNAL_HEADER 16					//magic and checkpoint at the start of the file
+
+// Checksum of a record body (FNV-1a), to tell a complete record from a torn or garbled one
+static uint32_t checksum(const char* data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void put_u32(string& out, uint32_t value) { out.append(reinterpret_cast<const char*>(&value), 4); }
+static void put_u64(string& out, uint64_t value) { out.append(reinterpret_cast<const char*>(&value), 8); }
+static uint32_t get_u32(const char* data) { uint32_t value; memcpy(&value, data, 4); return value; }
+static uint64_t get_u64(const char* data) { uint64_t value; memcpy(&value, data, 8); return value; }
+
+// Appends a record to out: [length | checksum | op u8 | number u64 | other_number u64 | path | other],
+// the strings as a u32 length and the bytes
+static void encode(string& out, const JournalRecord& record) {
+    size_t start = out.length();
+    put_u32(out, 0);
+    put_u32(out, 0);
+    out += (char)record.op;
+    put_u64(out, record.number);
+    put_u64(out, record.other_number);
+    put_u32(out, record.path.length());
+    out += record.path;
+    put_u32(out, record.other.length());
+    out += record.other;
+    //patch the length and the checksum of the body in
+    uint32_t length = out.length() - start - 8;
+    uint32_t sum = checksum(out.data() + start + 8, length);
+    memcpy(&out[start], &length, 4);
+    memcpy(&out[start + 4], &sum, 4);
+}
+
+// Decodes a record body, false if the fields don't fit in it
+static bool decode(const char* body, uint32_t length, JournalRecord& record) {
+    if (length < 21) { return false; }
+    record.op = (unsigned char)body[0];
+    record.number = get_u64(body + 1);
+    record.other_number = get_u64(body + 9);
+    uint32_t offset = 17;
+    uint32_t path_length = get_u32(body + offset);
+    offset += 4;
+    if (path_length > length - offset || length - offset - path_length < 4) { return false; }
+    record.path.assign(body + offset, path_length);
+    offset += path_length;
+    uint32_t other_length = get_u32(body + offset);
+    offset += 4;
+    if (other_length != length - offset) { return false; }
+    record.other.assign(body + offset, other_length);
+    return record.op >= J_MKDIR && record.op <= J_CP;
+}
+
+Journal::Journal() : fd(-1), current(JOURNAL_ASYNC), pending(), appended(0), durable(0), waiting(0), stop(false),
+                     failed(false), writing(false), log_bytes(0), records(0), syncs(0) {}
+
+Journal::~Journal() {
+    close();
+}
+
+unsigned long long Journal::open(const string& file, uint64_t checkpoint, const function<void(const JournalRecord&)>& apply) {
+    close();
+    filename = file;
+    //the member stays closed while replaying, so the replayed changes are not recorded again
+    int log = ::open(filename.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log < 0) { throw runtime_error("Cannot open the journal " + filename + ": " + strerror(errno)); }
+
+    //read the whole journal, the checkpoints keep it small
+    string data;
+    char buffer[64 * 1024];
+    while (true) {
+        ssize_t count = read(log, buffer, sizeof(buffer));
+        if (count < 0 && errno == EINTR) { continue; }
+        if (count <= 0) { break; }
+        data.append(buffer, count);
+    }
+
+    //replay the records that follow the checkpoint the tree was opened from, up to the first bad one
+    unsigned long long replayed = 0;
+    size_t end = 0;
+    if (data.length() >= JOURNAL_HEADER && memcmp(data.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) == 0
+        && get_u64(data.data() + 8) == checkpoint) {
+        end = JOURNAL_HEADER;
+        JournalRecord record;
+        while (data.length() - end >= 8) {
+            uint32_t length = get_u32(data.data() + end);
+            const char* body = data.data() + end + 8;
+            if (length > JOURNAL_MAX_RECORD || data.length() - end - 8 < length
+                || checksum(body, length) != get_u32(data.data() + end + 4) || !decode(body, length, record)) {
+                break;
+            }
+            apply(record);
+            replayed++;
+            end += 8 + length;
+        }
+    }
+
+    //cut off what could not be replayed, or start a journal for this checkpoint
+    bool ok = true;
+    if (end == 0) {
+        string header(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        put_u64(header, checkpoint);
+        ok = ftruncate(log, 0) == 0 && write(log, header.data(), header.length()) == (ssize_t)header.length();
+        end = JOURNAL_HEADER;
+    } else if (end < data.length()) {
+        ok = ftruncate(log, end) == 0;
+    }
+    if (!ok || fdatasync(log) != 0) {
+        ::close(log);
+        throw runtime_error("Cannot write the journal " + filename + ": " + strerror(errno));
+    }
+
+    fd = log;
+    stop = false;
+    failed = false;
+    log_bytes = end;
+    records = replayed;
+    syncs = 0;
+    flusher = thread(&Journal::flush_loop, this);
+    return replayed;
+}
+
+void Journal::close() {
+    if (fd < 0) { return; }
+    {
+        lock_guard<mutex> guard(lock);
+        stop = true;
+    }
+    wake.notify_one();
+    flusher.join();
+    ::close(fd);
+    fd = -1;
+}
+
+unsigned long long Journal::append(const JournalRecord& record) {
+    if (!enabled()) { return 0; }
+    lock_guard<mutex> guard(lock);
+    size_t before = pending.length();
+    encode(pending, record);
+    appended += pending.length() - before;
+    log_bytes += pending.length() - before;
+    records++;
+    //a large batch is written out without waiting for the timer
+    if (pending.length() >= JOURNAL_SYNC_BYTES && before < JOURNAL_SYNC_BYTES) { wake.notify_one(); }
+    return appended;
+}
+
+void Journal::wait(unsigned long long end) {
+    unique_lock<mutex> guard(lock);
+    if (durable >= end) { return; }
+    //ask for a sync now: the flusher takes every record appended so far, including those of the other waiters
+    waiting++;
+    wake.notify_one();
+    synced.wait(guard, [&]() { return durable >= end || failed; });
+    waiting--;
+    if (durable < end) { throw runtime_error("Cannot write the journal " + filename + ", the change may be lost in a crash"); }
+}
+
+void Journal::reset(uint64_t checkpoint) {
+    if (fd < 0) { return; }
+    unique_lock<mutex> guard(lock);
+    //the flusher may be writing the end of the old log
+    synced.wait(guard, [&]() { return !writing; });
+    //the records not written yet are in the image already
+    pending.clear();
+    string header(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    put_u64(header, checkpoint);
+    bool ok = ftruncate(fd, 0) == 0 && write(fd, header.data(), header.length()) == (ssize_t)header.length()
+              && fdatasync(fd) == 0;
+    durable = appended;
+    log_bytes = JOURNAL_HEADER;
+    records = 0;
+    syncs = 0;
+    failed = !ok;
+    synced.notify_all();
+    if (!ok) { throw runtime_error("Cannot write the journal " + filename + ": " + strerror(errno)); }
+}
+
+unsigned long long Journal::size() {
+    lock_guard<mutex> guard(lock);
+    return log_bytes;
+}
+
+void Journal::statistics(unsigned long long& record_count, unsigned long long& sync_count, unsigned long long& bytes, bool& broken) {
+    lock_guard<mutex> guard(lock);
+    record_count = records;
+    sync_count = syncs;
+    bytes = log_bytes;
+    broken = failed;
+}
+
+void Journal::write_out(const string& data) {
+    size_t done = 0;
+    while (done < data.length()) {
+        ssize_t count = write(fd, data.data() + done, data.length() - done);
+        if (count < 0 && errno == EINTR) { continue; }
+        if (count <= 0) { throw runtime_error("Cannot write the journal " + filename); }
+        done += count;
+    }
+    if (fdatasync(fd) != 0) { throw runtime_error("Cannot sync the journal " + filename); }
+}
+
+void Journal::flush_loop() {
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        if (pending.empty()) {
+            if (stop) { break; }
+            wake.wait(guard);
+            continue;
+        }
+        //without a waiter or a large batch, let the records of the next few milliseconds join this sync
+        if (!stop && waiting == 0 && pending.length() < JOURNAL_SYNC_BYTES) {
+            wake.wait_for(guard, chrono::milliseconds(JOURNAL_SYNC_MS));
+            if (pending.empty()) { continue; }
+        }
+        string data;
+        data.swap(pending);
+        unsigned long long end = appended;
+        writing = true;
+        guard.unlock();
+        bool ok = true;
+        try {
+            write_out(data);
+        } catch (exception &e) {
+            ok = false;
+        }
+        guard.lock();
+        writing = false;
+        if (ok) {
+            if (end > durable) { durable = end; }
+            syncs++;
+        } else {
+            failed = true;
+        }
+        synced.notify_all();
+    }
+}
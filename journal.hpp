@@ -0,0 +1,100 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+#include<cstdlib>
+#include<string>
+#include<stdint.h>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<functional>
+
+using namespace std;
+
+#define JOURNAL_MAGIC "VFSLOG1"
+#define JOURNAL_SYNC_MS 10					//records are made durable at least this often in async mode
+#define JOURNAL_SYNC_BYTES (256 << 10)		//or as soon as this much is waiting
+#define JOURNAL_MAX_RECORD (1 << 20)		//longer records are taken as a torn or corrupt tail
+
+//Operations recorded in the journal, with the fields of JournalRecord they use
+enum JournalOp
+{
+	J_MKDIR = 1,		//path, other_number (creation time)
+	J_TOUCH,			//path, number (size), other_number (creation time)
+	J_RM,				//path
+	J_MV,				//path (file or folder), other (folder)
+	J_RECOVER,			//path, empty for the oldest item
+	J_EMPTYBIN,			//nothing
+	J_BINLIMIT,			//number (items), other_number (bytes)
+	J_CP				//path (file or folder), other (folder), other_number (creation time of the copies)
+};
+
+enum JournalMode
+{
+	JOURNAL_OFF,		//nothing is recorded
+	JOURNAL_ASYNC,		//commands return at once, records are synced by the group commit within JOURNAL_SYNC_MS
+	JOURNAL_SYNC		//commands return once their record is on disk, concurrent ones share an fsync
+};
+
+//A change of the tree, with absolute paths so that it can be replayed without the session that made it
+struct JournalRecord
+{
+	int op;							//JournalOp
+	string path;					//path the operation applies to
+	string other;					//destination folder of mv and cp, creation date of mkdir and touch in older journals
+	unsigned long long number;		//size of touch, item limit of binlimit
+	unsigned long long other_number;	//byte limit of binlimit, creation time of mkdir, touch and cp
+
+	JournalRecord(int o = 0) : op(o), number(0), other_number(0) {}
+};
+
+//Append-only log of the changes made since the last checkpoint (the last saved image). The file starts
+//with a header naming the checkpoint it belongs to, then holds records [length u32 | checksum u32 | body].
+//Records are appended to a buffer in memory; a background thread writes the buffer out and syncs it,
+//so that one fsync covers every record appended meanwhile (group commit).
+class Journal
+{
+	private:
+		int fd;							//the journal file, -1 when closed
+		string filename;				//path of the journal file
+		JournalMode current;			//mode of the journal
+		mutex lock;						//guards the fields below
+		condition_variable wake;		//wakes the flusher up
+		condition_variable synced;		//signals that durable moved forward
+		string pending;					//encoded records not written yet
+		unsigned long long appended;	//bytes ever appended, a position in the log that checkpoints don't reset
+		unsigned long long durable;		//position up to which the log is on disk or in a checkpoint
+		int waiting;					//number of threads waiting for a sync
+		bool stop;						//asks the flusher to stop
+		bool failed;					//a write or a sync failed since the checkpoint
+		bool writing;					//the flusher is writing a batch out
+		thread flusher;					//background group commit
+		unsigned long long log_bytes;	//size of the log since the checkpoint, header and pending records included
+		unsigned long long records;		//records appended since the checkpoint
+		unsigned long long syncs;		//fsyncs done since the checkpoint
+
+		void flush_loop();
+		void write_out(const string& data);		//Write at the end of the file and sync, throws on failure
+
+	public:
+		Journal();
+		~Journal();
+		Journal(const Journal&) = delete;
+		Journal& operator=(const Journal&) = delete;
+
+		//Read the records of the journal of a checkpoint and pass them to apply, then open the journal to
+		//record the next changes. A journal of another checkpoint is discarded, a torn last record is cut off.
+		//Returns the number of records replayed
+		unsigned long long open(const string& file, uint64_t checkpoint, const function<void(const JournalRecord&)>& apply);
+		void close();						//Sync what is pending and stop the flusher
+		unsigned long long append(const JournalRecord& record);	//Record a change, returns its end in the log, 0 if not recording
+		void wait(unsigned long long end);	//Wait until the log is durable up to end
+		void reset(uint64_t checkpoint);	//Empty the log once the changes are in the image of a new checkpoint
+		bool enabled() const { return fd >= 0 && current != JOURNAL_OFF; }
+		bool is_open() const { return fd >= 0; }
+		JournalMode mode() const { return current; }
+		void set_mode(JournalMode mode) { current = mode; }
+		unsigned long long size();			//Bytes in the log, header included
+		void statistics(unsigned long long& record_count, unsigned long long& sync_count, unsigned long long& bytes, bool& broken);
+};
+
+#endif
@@ -1,15 +1,83 @@
 #include<iostream>
 #include<sstream>
 #include<stdlib.h>
+#include<fcntl.h>
+#include<unistd.h>
 #include "vfs.hpp"
 #include "vector.hpp"
 #include "queue.hpp"
+#include "server.hpp"
+#include "client.hpp"
+#include "batch.hpp"
 using namespace std;
 
+// Prints how to start the program
+static void usage(const char* program) {
+	cout << "Usage: " << program << "                        interactive console, or batch mode when stdin is not a terminal\n"
+	     << "       " << program << " -f <script>               run the commands of a script without prompts\n"
+	     << "       " << program << " --serve <socket> [loops]  serve the VFS on a Unix socket until SIGINT/SIGTERM\n"
+	     << "       " << program << " --client <socket>         send the commands read from stdin to a server\n"
+	     << "       " << program << " --load <socket> [connections] [requests] [depth] [commands]\n"
+	     << "                                  load a server, commands separated by ';' (default pwd)" << endl;
+}
 
-int main()
+int main(int argc, char** argv)
 {
+	//modes other than the console
+	if (argc > 1) {
+		string mode = argv[1];
+		try
+		{
+			if (mode == "--serve" && argc >= 3) {
+				VFS vfs;
+				Server server(vfs, argv[2], argc >= 4 ? atoi(argv[3]) : 0);
+				cout << "Serving the Virtual File System on " << argv[2] << endl;
+				server.run();
+				vfs.close_journal();
+				std::exit(EXIT_SUCCESS);
+			}
+			if (mode == "-f" && argc >= 3) {
+				int fd = open(argv[2], O_RDONLY | O_CLOEXEC);
+				if (fd < 0) { throw runtime_error(string("Cannot open ") + argv[2]); }
+				VFS vfs;
+				run_batch(vfs, fd);
+				vfs.close_journal();
+				std::exit(EXIT_SUCCESS);
+			}
+			if (mode == "--client" && argc >= 3) { return run_client(argv[2]); }
+			if (mode == "--load" && argc >= 3) {
+				return run_load(argv[2], argc >= 4 ? atoi(argv[3]) : 1, argc >= 5 ? atoi(argv[4]) : 100000,
+				                argc >= 6 ? atoi(argv[5]) : 16, argc >= 7 ? argv[6] : "pwd");
+			}
+		}
+		catch(exception &e)
+		{
+			cout<<"Exception: "<<e.what()<<endl;
+			return EXIT_FAILURE;
+		}
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	//commands piped in are run as a batch
+	if (!isatty(STDIN_FILENO)) {
+		VFS vfs;
+		int status = EXIT_SUCCESS;
+		try
+		{
+			run_batch(vfs, STDIN_FILENO);
+		}
+		catch(exception &e)
+		{
+			cout<<"Exception: "<<e.what()<<endl;
+			status = EXIT_FAILURE;
+		}
+		vfs.close_journal();
+		std::exit(status);
+	}
+
 	VFS vfs;
+	Session* session = vfs.open_session(cout);
 	cout << "Welcome to the Virtual File system! Use 'help' if you are in doubt." << endl;
 	while(true)
 	{
@@ -18,7 +86,8 @@ int main()
 		string parameter1;
 		string parameter2;
 		cout<<">";
-		getline(cin,user_input);
+		//end of input (Ctrl-D) leaves without saving, like closing the terminal, the journal keeps the changes
+		if(!getline(cin,user_input))	{ cout << endl; vfs.close_journal(); std::exit(EXIT_SUCCESS); }
 
 		// parse userinput into command and parameter(s)
 		stringstream sstr(user_input);
@@ -28,31 +97,9 @@ int main()
 
 		try
 		{
-			//Required commands
-			if(command=="help")		vfs.help();
-			else if(command=="pwd")			cout<<vfs.pwd()<<endl;
-			else if(command=="ls") 			vfs.ls(parameter1);
-			else if(command=="mkdir")		vfs.mkdir(parameter1);
-			else if(command=="touch")		{
-			if (parameter2.empty()) {
-				throw runtime_error("Cannot create a file without specifying its size. Please enter the command in the form of 'touch file_name size'");
-			} else {vfs.touch(parameter1,stoi(parameter2)); }
-			}
-			else if(command=="cd")			vfs.cd(parameter1);
-			else if(command=="rm")			vfs.rm(parameter1);
-			else if(command=="size")		vfs.size(parameter1);
-			else if(command=="showbin")		vfs.showbin();
-			else if(command=="emptybin")	vfs.emptybin();
-			else if(command=="exit")		{vfs.exit(); return(EXIT_SUCCESS);}
-			
-			
-			//optional commands
-			else if(command=="find")		vfs.find(parameter1);
-			else if(command=="mv")			vfs.mv(parameter1, parameter2);
-			else if(command=="recover")		vfs.recover();
-			else if(command=="clear")		system("clear");
-			
-			else 							cout<<command<<": command not found"<<endl;
+			//the commands run in the session of the console, clearing the screen is the only local one
+			if(command=="clear")			system("clear");
+			else if(!vfs.execute(*session, command, parameter1, parameter2))	{ vfs.close_journal(); std::exit(EXIT_SUCCESS); }
 		}
 		catch(exception &e)
 		{
@@ -60,4 +107,4 @@ int main()
 		}
 
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,77 @@
+#include<cstdlib>
+#include<string>
+#include<atomic>
+
+#include "pathcache.hpp"
+
+using namespace std;
+
+PathCache::PathCache(int size) : capacity(size), count(0), hand(0), generation(0) {
+    entries = new Entry[capacity];
+    for (int i = 0; i < RWLOCK_SHARDS; ++i) {
+        counters[i].hits = 0;
+        counters[i].misses = 0;
+    }
+}
+
+bool PathCache::find(const string& path, Inode*& node, Inode*& parent) {
+    ReadGuard guard(lock);
+    Counters& mine = counters[lock.shard()];
+    int* slot = slots.find(path);
+    if (slot == nullptr || entries[*slot].generation != generation.load(memory_order_relaxed)) {
+        mine.misses.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+    mine.hits.fetch_add(1, memory_order_relaxed);
+    Entry& entry = entries[*slot];
+    node = entry.node;
+    parent = entry.parent;
+    //hot entries are already marked, reading the bit first keeps their cache line shared
+    if (!entry.referenced.load(memory_order_relaxed)) { entry.referenced.store(true, memory_order_relaxed); }
+    return true;
+}
+
+void PathCache::insert(const string& path, Inode* node, Inode* parent) {
+    WriteGuard guard(lock);
+    unsigned long long current = generation.load(memory_order_relaxed);
+    int* slot = slots.find(path);
+    int i;
+    if (slot != nullptr) {
+        //a stale entry of the same path, or another reader resolved it meanwhile
+        i = *slot;
+    } else if (count < capacity) {
+        i = count++;
+        entries[i].path = path;
+        slots[path] = i;
+    } else {
+        //sweep the clock: stale entries go first, referenced ones get a second chance
+        while (entries[hand].generation == current && entries[hand].referenced.load(memory_order_relaxed)) {
+            entries[hand].referenced.store(false, memory_order_relaxed);
+            hand = (hand + 1) % capacity;
+        }
+        i = hand;
+        hand = (hand + 1) % capacity;
+        slots.erase(entries[i].path);
+        entries[i].path = path;
+        slots[path] = i;
+    }
+    entries[i].node = node;
+    entries[i].parent = parent;
+    entries[i].generation = current;
+    entries[i].referenced.store(false, memory_order_relaxed);
+}
+
+void PathCache::invalidate() {
+    generation.fetch_add(1, memory_order_relaxed);
+}
+
+void PathCache::statistics(int& size, unsigned long long& hits, unsigned long long& misses) {
+    ReadGuard guard(lock);
+    size = count;
+    hits = 0;
+    misses = 0;
+    for (int i = 0; i < RWLOCK_SHARDS; ++i) {
+        hits += counters[i].hits.load(memory_order_relaxed);
+        misses += counters[i].misses.load(memory_order_relaxed);
+    }
+}
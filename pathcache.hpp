@@ -0,0 +1,56 @@
+#ifndef PATHCACHE_H
+#define PATHCACHE_H
+#include<cstdlib>
+#include<string>
+#include<atomic>
+#include "hashmap.hpp"
+#include "rwlock.hpp"
+
+using namespace std;
+
+#define PATH_CACHE_SIZE 4096			//absolute paths remembered by the resolver
+
+class Inode;
+
+//Bounded cache of resolved absolute paths: the Inode a path leads to and its parent. A generation
+//number invalidates every entry at once when the tree loses a link; entries from an older generation
+//are misses and get reused in place. Lookups only take the cache lock for reading, on the shard of
+//their thread, so readers don't serialize on it: a hit just sets the referenced bit of its entry, and
+//a CLOCK sweep at insertion evicts an entry that wasn't referenced since the hand last passed it
+class PathCache
+{
+	private:
+		struct Entry {
+			string path;					//absolute path, key of the entry
+			Inode* node;					//Inode the path leads to
+			Inode* parent;					//its parent
+			unsigned long long generation;	//generation the entry was resolved in
+			atomic<bool> referenced;		//hit since the hand of the clock last passed
+		};
+		struct Counters {
+			atomic<unsigned long long> hits;
+			atomic<unsigned long long> misses;
+			char padding[64 - 2 * sizeof(atomic<unsigned long long>)];	//keeps the counters of each shard on a cache line of their own
+		};
+		Entry* entries;						//capacity entries, the first count are in use
+		int capacity;
+		int count;
+		int hand;							//next entry the clock looks at for eviction
+		HashMap<string, int> slots;			//entry of each cached path
+		atomic<unsigned long long> generation;	//current generation
+		Counters counters[RWLOCK_SHARDS];	//hits and misses, by the shard of the thread
+		SharedLock lock;					//read for lookups, write for insertions
+
+	public:
+		PathCache(int size = PATH_CACHE_SIZE);
+		~PathCache() { delete[] entries; }
+		PathCache(const PathCache&) = delete;
+		PathCache& operator=(const PathCache&) = delete;
+
+		bool find(const string& path, Inode*& node, Inode*& parent);	//Cached Inode and parent of a path, false on a miss
+		void insert(const string& path, Inode* node, Inode* parent);	//Remember a resolved path, evicting one not used lately
+		void invalidate();					//Forget every path
+		void statistics(int& size, unsigned long long& hits, unsigned long long& misses);
+};
+
+#endif
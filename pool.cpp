@@ -0,0 +1,115 @@
+#include<cstdlib>
+#include<cstring>
+#include<string>
+#include<stdexcept>
+#include<utility>
+
+#include "pool.hpp"
+
+using namespace std;
+
+const char Name::empty[3] = { 0, 0, 0 };
+
+StringPool::~StringPool() {
+    for (int i = 0; i < chunk_count; ++i) { delete[] chunks[i]; }
+    delete[] chunks;
+    delete[] slots;
+}
+
+Name StringPool::intern(const char* name, size_t length) {
+    if (length > 0xFFFF) { throw runtime_error("Name is too long"); }
+    // Keep the set at most half full
+    if ((count + 1) * 2 > capacity) { rehash(capacity == 0 ? 1024 : capacity * 2); }
+    unsigned int h = hash_name(name, length);
+    int mask = capacity - 1;
+    int i = h & mask;
+    while (slots[i].chars != nullptr) {
+        Name found(slots[i].chars);
+        if (slots[i].hash == h && found.length() == length && names_equal(found.data(), name, length)) {
+            return found;
+        }
+        i = (i + 1) & mask;
+    }
+    // Not interned yet: copy it into the pool
+    slots[i].hash = h;
+    slots[i].chars = store(name, length);
+    count++;
+    return Name(slots[i].chars);
+}
+
+void StringPool::swap(StringPool& other) {
+    std::swap(slots, other.slots);
+    std::swap(capacity, other.capacity);
+    std::swap(count, other.count);
+    std::swap(chunk, other.chunk);
+    std::swap(chunk_used, other.chunk_used);
+    std::swap(chunks, other.chunks);
+    std::swap(chunk_count, other.chunk_count);
+    std::swap(chunk_capacity, other.chunk_capacity);
+    std::swap(total_bytes, other.total_bytes);
+}
+
+bool StringPool::find(const string& name, Name& found) const {
+    if (count == 0) { return false; }
+    unsigned int h = hash_name(name.data(), name.length());
+    int mask = capacity - 1;
+    for (int i = h & mask; slots[i].chars != nullptr; i = (i + 1) & mask) {
+        Name candidate(slots[i].chars);
+        if (slots[i].hash == h && candidate == name) {
+            found = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Copies a name after its two length bytes and a NUL terminator, returns a pointer to its first character.
+char* StringPool::store(const char* name, size_t length) {
+    size_t needed = length + 3;
+    char* stored;
+    if (needed > NAME_CHUNK_BYTES) {
+        // Names that don't fit a chunk get a chunk of their own
+        stored = add_chunk(needed);
+    } else {
+        if (chunk == nullptr || chunk_used + needed > NAME_CHUNK_BYTES) {
+            chunk = add_chunk(NAME_CHUNK_BYTES);
+            chunk_used = 0;
+        }
+        stored = chunk + chunk_used;
+        chunk_used += needed;
+    }
+    stored[0] = (char)(length & 0xFF);
+    stored[1] = (char)(length >> 8);
+    memcpy(stored + 2, name, length);
+    stored[length + 2] = '\0';
+    return stored + 2;
+}
+
+char* StringPool::add_chunk(size_t size) {
+    if (chunk_count == chunk_capacity) {
+        chunk_capacity = (chunk_capacity == 0) ? 16 : chunk_capacity * 2;
+        char** bigger = new char*[chunk_capacity];
+        for (int i = 0; i < chunk_count; ++i) { bigger[i] = chunks[i]; }
+        delete[] chunks;
+        chunks = bigger;
+    }
+    chunks[chunk_count++] = new char[size];
+    total_bytes += size;
+    return chunks[chunk_count - 1];
+}
+
+void StringPool::rehash(int new_capacity) {
+    Slot* old_slots = slots;
+    int old_capacity = capacity;
+    slots = new Slot[new_capacity];
+    for (int i = 0; i < new_capacity; ++i) { slots[i].chars = nullptr; }
+    capacity = new_capacity;
+    int mask = capacity - 1;
+    for (int j = 0; j < old_capacity; ++j) {
+        if (old_slots[j].chars == nullptr) { continue; }
+        int i = old_slots[j].hash & mask;
+        while (slots[i].chars != nullptr) { i = (i + 1) & mask; }
+        slots[i] = old_slots[j];
+    }
+    delete[] old_slots;
+}
@@ -0,0 +1,255 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include<cstdlib>
+#include<cstring>
+#include<string>
+#include<ostream>
+#include<new>
+#include<utility>
+#include<stdexcept>
+#include "simd.hpp"
+using namespace std;
+
+#define POOL_BLOCK_BYTES (1 << 16)		//size (and alignment) of a block of the slab allocator
+#define NAME_CHUNK_BYTES (1 << 16)		//size of a chunk of the string pool
+
+// FNV-1a hash of a name
+inline unsigned int hash_name(const char* name, size_t length) {
+    unsigned int h = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        h ^= static_cast<unsigned char>(name[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+//Slab allocator handing out objects of type T from contiguous 64 KiB blocks.
+//Destroyed objects go to a free list and their slots are reused first; the blocks are only
+//returned to the system when the pool itself is destroyed.
+template <typename T>
+class Pool
+{
+	private:
+		struct Block {
+			Block* next;				//next block of the pool
+			int live;					//number of live objects in the block
+			unsigned long long used[(POOL_BLOCK_BYTES / sizeof(T) + 63) / 64];	//one bit per slot holding a live object
+		};
+		struct FreeSlot {
+			FreeSlot* next;				//next free slot, stored in the slot itself
+		};
+		static const size_t SLOT_OFFSET = (sizeof(Block) + alignof(T) - 1) / alignof(T) * alignof(T);
+		static const int SLOTS = (POOL_BLOCK_BYTES - SLOT_OFFSET) / sizeof(T);
+
+		Block* blocks;					//list of all the blocks
+		Block* spare;					//blocks taken ahead by reserve, not used yet
+		FreeSlot* free_list;			//slots of destroyed objects
+		int free_count;					//number of slots in the free list
+		int unused;						//index of the first never used slot of the newest block
+		int live_count;					//number of live objects
+		int block_count;				//number of blocks, the spare ones included
+
+		T* slot(Block* block, int i) { return reinterpret_cast<T*>(reinterpret_cast<char*>(block) + SLOT_OFFSET + i * sizeof(T)); }
+		T* allocate();
+
+	public:
+		Pool() : blocks(nullptr), spare(nullptr), free_list(nullptr), free_count(0), unused(SLOTS), live_count(0), block_count(0) {}
+		~Pool();
+		Pool(const Pool&) = delete;
+		Pool& operator=(const Pool&) = delete;
+
+		template <typename... Args>
+		T* create(Args&&... args);		//Construct an object in a free slot
+		void destroy(T* object);		//Destroy an object and recycle its slot
+		void reserve(int count);		//Take the blocks for count more objects from the system at once
+		template <typename F>
+		void for_each(F visit);			//Call visit on every live object
+
+		int live() const { return live_count; }				//Number of live objects
+		int blocks_allocated() const { return block_count; }	//Number of blocks taken from the system
+		int slots_per_block() const { return SLOTS; }
+		size_t bytes() const { return (size_t)block_count * POOL_BLOCK_BYTES; }
+};
+
+//Interned name: a pointer to a NUL-terminated string owned by a StringPool, with its length
+//stored in the two bytes in front of it. Equal names interned in the same pool share the pointer.
+class Name
+{
+	private:
+		const char* chars;
+
+	public:
+		Name() : chars(empty + 2) {}
+		explicit Name(const char* interned) : chars(interned) {}
+
+		const char* data() const { return chars; }
+		const char* c_str() const { return chars; }
+		size_t length() const { return (size_t)(unsigned char)chars[-2] | ((size_t)(unsigned char)chars[-1] << 8); }
+		string str() const { return string(chars, length()); }
+		bool operator==(const string& other) const { return other.length() == length() && names_equal(chars, other.data(), length()); }
+		bool operator!=(const string& other) const { return !(*this == other); }
+		bool operator==(const Name& other) const { return chars == other.chars; }
+
+		static const char empty[3];		//storage of the empty name
+};
+
+inline ostream& operator<<(ostream& out, const Name& name) { return out << name.c_str(); }
+inline string operator+(const char* left, const Name& right) { return left + right.str(); }
+inline string operator+(const string& left, const Name& right) { return left + right.str(); }
+
+//Pool of interned names, stored back to back in large chunks and found through an open addressing hash set.
+//Names are never removed one by one: the pool only grows with every distinct name seen, until its owner
+//interns the names still in use into a new pool and swaps it in
+class StringPool
+{
+	private:
+		struct Slot {
+			unsigned int hash;			//hash of the name
+			const char* chars;			//interned name, nullptr if the slot is empty
+		};
+		Slot* slots;					//hash set of the interned names, capacity is a power of two
+		int capacity;					//number of slots
+		int count;						//number of interned names
+		char* chunk;					//chunk the next names are copied into
+		size_t chunk_used;				//bytes used in the current chunk
+		char** chunks;					//all the chunks, to free them
+		int chunk_count;
+		int chunk_capacity;
+		size_t total_bytes;				//bytes taken by the chunks
+
+		void rehash(int new_capacity);
+		char* store(const char* name, size_t length);
+		char* add_chunk(size_t size);
+
+	public:
+		StringPool() : slots(nullptr), capacity(0), count(0), chunk(nullptr), chunk_used(0),
+			chunks(nullptr), chunk_count(0), chunk_capacity(0), total_bytes(0) {}
+		~StringPool();
+		StringPool(const StringPool&) = delete;
+		StringPool& operator=(const StringPool&) = delete;
+
+		Name intern(const char* name, size_t length);	//Return the interned copy of a name, adding it if needed
+		Name intern(const string& name) { return intern(name.data(), name.length()); }
+		bool find(const string& name, Name& found) const;	//Look a name up without interning it, false if it was never interned
+		void swap(StringPool& other);					//Exchange the names of two pools
+		int size() const { return count; }				//Number of distinct names
+		size_t bytes() const { return total_bytes; }	//Bytes taken by the chunks
+};
+
+// Takes a slot from the free list, or the next never used slot, adding a block when all are used.
+template <typename T>
+T* Pool<T>::allocate() {
+    if (free_list != nullptr) {
+        FreeSlot* free_slot = free_list;
+        free_list = free_slot->next;
+        free_count--;
+        return reinterpret_cast<T*>(free_slot);
+    }
+    if (unused == SLOTS) {
+        Block* block = spare;
+        if (block != nullptr) {
+            spare = block->next;
+        } else {
+            // Blocks are aligned on their size, so the block of an object is found by masking its address
+            void* memory = nullptr;
+            if (posix_memalign(&memory, POOL_BLOCK_BYTES, POOL_BLOCK_BYTES) != 0) { throw bad_alloc(); }
+            block = static_cast<Block*>(memory);
+            block_count++;
+        }
+        block->next = blocks;
+        block->live = 0;
+        memset(block->used, 0, sizeof(block->used));
+        blocks = block;
+        unused = 0;
+    }
+    return slot(blocks, unused++);
+}
+
+// Takes every block the next count objects need beyond the free slots, so that creating them never
+// goes to the system allocator.
+template <typename T>
+void Pool<T>::reserve(int count) {
+    long long needed = (long long)count - free_count - (SLOTS - unused);
+    for (Block* block = spare; block != nullptr; block = block->next) { needed -= SLOTS; }
+    for (; needed > 0; needed -= SLOTS) {
+        void* memory = nullptr;
+        if (posix_memalign(&memory, POOL_BLOCK_BYTES, POOL_BLOCK_BYTES) != 0) { throw bad_alloc(); }
+        Block* block = static_cast<Block*>(memory);
+        block->next = spare;
+        spare = block;
+        block_count++;
+    }
+}
+
+template <typename T>
+template <typename... Args>
+T* Pool<T>::create(Args&&... args) {
+    T* object = allocate();
+    try {
+        new (object) T(std::forward<Args>(args)...);
+    } catch (...) {
+        FreeSlot* free_slot = reinterpret_cast<FreeSlot*>(object);
+        free_slot->next = free_list;
+        free_list = free_slot;
+        free_count++;
+        throw;
+    }
+    // Mark the slot as live so that the destructor of the pool can find it
+    Block* block = reinterpret_cast<Block*>(reinterpret_cast<size_t>(object) & ~(size_t)(POOL_BLOCK_BYTES - 1));
+    int i = (reinterpret_cast<char*>(object) - reinterpret_cast<char*>(slot(block, 0))) / sizeof(T);
+    block->used[i / 64] |= 1ULL << (i % 64);
+    block->live++;
+    live_count++;
+    return object;
+}
+
+template <typename T>
+void Pool<T>::destroy(T* object) {
+    object->~T();
+    Block* block = reinterpret_cast<Block*>(reinterpret_cast<size_t>(object) & ~(size_t)(POOL_BLOCK_BYTES - 1));
+    int i = (reinterpret_cast<char*>(object) - reinterpret_cast<char*>(slot(block, 0))) / sizeof(T);
+    block->used[i / 64] &= ~(1ULL << (i % 64));
+    block->live--;
+    live_count--;
+    // Push the slot on the free list so that the next object reuses it
+    FreeSlot* free_slot = reinterpret_cast<FreeSlot*>(object);
+    free_slot->next = free_list;
+    free_list = free_slot;
+    free_count++;
+}
+
+// Visits the live objects block by block, following the used bitmaps
+template <typename T>
+template <typename F>
+void Pool<T>::for_each(F visit) {
+    for (Block* block = blocks; block != nullptr; block = block->next) {
+        for (int w = 0; block->live > 0 && w < (int)(sizeof(block->used) / sizeof(block->used[0])); ++w) {
+            for (unsigned long long bits = block->used[w]; bits != 0; bits &= bits - 1) {
+                visit(slot(block, w * 64 + __builtin_ctzll(bits)));
+            }
+        }
+    }
+}
+
+// Destroys the objects that are still alive, block by block, then frees all the blocks at once.
+template <typename T>
+Pool<T>::~Pool() {
+    while (blocks != nullptr) {
+        Block* block = blocks;
+        blocks = block->next;
+        for (int w = 0; block->live > 0 && w < (int)(sizeof(block->used) / sizeof(block->used[0])); ++w) {
+            for (unsigned long long bits = block->used[w]; bits != 0; bits &= bits - 1) {
+                slot(block, w * 64 + __builtin_ctzll(bits))->~T();
+            }
+        }
+        free(block);
+    }
+    while (spare != nullptr) {
+        Block* block = spare;
+        spare = block->next;
+        free(block);
+    }
+}
+
+#endif
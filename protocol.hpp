@@ -0,0 +1,73 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include<cstdlib>
+#include<cstring>
+#include<string>
+#include<stdint.h>
+#include "commands.hpp"
+using namespace std;
+
+//Binary protocol of the server mode. Every message is a frame made of a 4-byte length (of the rest of
+//the frame) followed by its body; integers are little-endian. Clients may send many requests without
+//waiting, the responses come back in the same order with the id of their request.
+//
+//Request body:  id (4) | opcode (1, see commands.hpp) | length of parameter 1 (2) | parameter 1 | length of parameter 2 (2) | parameter 2
+//Response body: id (4) | status (1) | output of the command, or the error message if status is STATUS_ERROR
+
+#define PROTOCOL_MAX_FRAME (1 << 20)	//larger requests are refused and the connection is closed
+#define PROTOCOL_MAX_RESPONSE (256 << 20)	//output of a command the server sends back at most, larger output is an error
+#define STATUS_OK 0						//the command ran, the payload is its output
+#define STATUS_ERROR 1					//the command threw, the payload is the message of the exception
+
+// Splits a command line like the console does: the command, the first parameter, then the rest of the line
+inline void split_command(const string& line, string& command, string& parameter1, string& parameter2) {
+    size_t first = line.find(' ');
+    command = line.substr(0, first);
+    parameter1.clear();
+    parameter2.clear();
+    if (first == string::npos) { return; }
+    size_t second = line.find(' ', first + 1);
+    parameter1 = line.substr(first + 1, second == string::npos ? string::npos : second - first - 1);
+    if (second != string::npos) { parameter2 = line.substr(second + 1); }
+}
+
+inline void put_u16(string& out, uint16_t value) { out.append(reinterpret_cast<const char*>(&value), 2); }
+inline void put_u32(string& out, uint32_t value) { out.append(reinterpret_cast<const char*>(&value), 4); }
+inline uint16_t get_u16(const char* in) { uint16_t value; memcpy(&value, in, 2); return value; }
+inline uint32_t get_u32(const char* in) { uint32_t value; memcpy(&value, in, 4); return value; }
+
+// Appends a request frame
+inline void encode_request(string& out, uint32_t id, int opcode, const string& parameter1, const string& parameter2) {
+    put_u32(out, (uint32_t)(4 + 1 + 2 + parameter1.length() + 2 + parameter2.length()));
+    put_u32(out, id);
+    out += (char)opcode;
+    put_u16(out, (uint16_t)parameter1.length());
+    out += parameter1;
+    put_u16(out, (uint16_t)parameter2.length());
+    out += parameter2;
+}
+
+// Appends a response frame
+inline void encode_response(string& out, uint32_t id, int status, const string& payload) {
+    put_u32(out, (uint32_t)(4 + 1 + payload.length()));
+    put_u32(out, id);
+    out += (char)status;
+    out += payload;
+}
+
+// Splits a request body, false if it is malformed
+inline bool decode_request(const char* body, size_t length, uint32_t& id, int& opcode, string& parameter1, string& parameter2) {
+    if (length < 9) { return false; }
+    id = get_u32(body);
+    opcode = (unsigned char)body[4];
+    size_t length1 = get_u16(body + 5);
+    if (7 + length1 + 2 > length) { return false; }
+    parameter1.assign(body + 7, length1);
+    size_t length2 = get_u16(body + 7 + length1);
+    if (9 + length1 + length2 != length) { return false; }
+    parameter2.assign(body + 9 + length1, length2);
+    return true;
+}
+
+#endif
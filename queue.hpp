@@ -4,6 +4,7 @@
 
 #include <cstdlib>
 #include <stdexcept>
+#include <utility>
 
 //Exceptions Defenition
 class QueueFull : public exception
@@ -33,10 +34,14 @@ private:
     int size; // Current number of elements in the queue
     int front; // Index of the front element in the queue
     int rear; // Index to the position where the next element will be inserted
+    bool growable; // If true, a full queue doubles its capacity instead of throwing QueueFull
+
+    // Function to move the elements to a ring of the given capacity
+    void resize(int new_capacity);
 
 public:
     // Constructor with default capacity set to 10
-    Queue(int capacity = 10);
+    Queue(int capacity = 10, bool growable = false);
     // Destructor to deallocate memory used by the queue
     ~Queue();
     // Function to add an element to the queue
@@ -49,11 +54,15 @@ public:
     bool isFull() const;
     // Function to get the front element of the queue
     T front_element() const;
+    // Function to get the i-th element from the front of the queue
+    T& at(int i);
+    // Function to get the number of elements in the queue
+    int length() const;
 };
 
 // Constructor implementation
 template <typename T>
-Queue<T>::Queue(int cap) : capacity(cap), size(0), front(0), rear(0) {
+Queue<T>::Queue(int cap, bool grow) : capacity(cap), size(0), front(0), rear(0), growable(grow) {
     array = new T[capacity]; // Allocating memory for the queue
 }
 
@@ -66,12 +75,16 @@ Queue<T>::~Queue() {
 // enqueue() implementation
 template <typename T>
 void Queue<T>::enqueue(T element) {
+    // A growable queue makes room instead of being full
+    if (isFull() && growable) {
+        resize(capacity == 0 ? 16 : capacity * 2);
+    }
     // Check if the queue is already full
     if (isFull()) {
         // Throw a QueueFull exception if there's no space left
         throw QueueFull();
     } else {
-        array[rear] = element; // Inserting the element at the rear
+        array[rear] = std::move(element); // Inserting the element at the rear
         rear = (rear + 1) % capacity; // Updating rear position
         size++; // Increasing the size of the queue
     }
@@ -85,6 +98,7 @@ void Queue<T>::dequeue() {
         // Throw a QueueEmpty exception if there are no elements left
         throw QueueEmpty();
     } else {
+        array[front] = T(); // Releasing what the element holds
         front = (front + 1) % capacity; // Updating the front position
         size--; // Decreasing the size of the queue
     }
@@ -108,4 +122,34 @@ T Queue<T>::front_element() const {
     return array[front]; // Returns the front element
 }
 
+// at() implementation
+template <typename T>
+T& Queue<T>::at(int i) {
+    if (i < 0 || i >= size) {
+        throw std::out_of_range("Invalid index.");
+    }
+    return array[(front + i) % capacity]; // Elements are stored from front, wrapping around
+}
+
+// length() implementation
+template <typename T>
+int Queue<T>::length() const {
+    return size;
+}
+
+// resize() implementation
+template <typename T>
+void Queue<T>::resize(int new_capacity) {
+    T* new_array = new T[new_capacity];
+    // Copy the elements in order, so that the front ends up at index 0
+    for (int i = 0; i < size; ++i) {
+        new_array[i] = std::move(array[(front + i) % capacity]);
+    }
+    delete[] array;
+    array = new_array;
+    capacity = new_capacity;
+    front = 0;
+    rear = size % capacity;
+}
+
 #endif // QUEUE_H
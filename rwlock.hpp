@@ -0,0 +1,90 @@
+#ifndef RWLOCK_H
+#define RWLOCK_H
+
+#include<pthread.h>
+#include<atomic>
+#include<stdexcept>
+using namespace std;
+
+#define RWLOCK_SHARDS 16				//number of reader shards, readers on different shards never share a cache line
+
+//Reader/writer lock split into shards: a reader only locks the shard of its thread, so readers on different
+//cores don't bounce a shared counter between their caches; a writer locks every shard in order.
+//Writers are preferred, a steady flow of readers can't starve them.
+class SharedLock
+{
+	private:
+		struct Shard {
+			pthread_rwlock_t lock;
+			char padding[64 - sizeof(pthread_rwlock_t) % 64];	//keeps each shard on cache lines of its own
+		};
+		Shard shards[RWLOCK_SHARDS];
+		atomic<int> next_shard;			//shard given to the next thread that reads
+
+	public:
+		SharedLock();
+		~SharedLock();
+		SharedLock(const SharedLock&) = delete;
+		SharedLock& operator=(const SharedLock&) = delete;
+
+		void lock_shared() { pthread_rwlock_rdlock(&shards[shard()].lock); }
+		void unlock_shared() { pthread_rwlock_unlock(&shards[shard()].lock); }
+		void lock();
+		void unlock();
+		int shard();					//Shard of the calling thread, also used to spread per-thread counters
+};
+
+//Holds a SharedLock for reading until the end of the scope
+class ReadGuard
+{
+	private:
+		SharedLock& lock;
+	public:
+		explicit ReadGuard(SharedLock& l) : lock(l) { lock.lock_shared(); }
+		~ReadGuard() { lock.unlock_shared(); }
+		ReadGuard(const ReadGuard&) = delete;
+		ReadGuard& operator=(const ReadGuard&) = delete;
+};
+
+//Holds a SharedLock for writing until the end of the scope
+class WriteGuard
+{
+	private:
+		SharedLock& lock;
+	public:
+		explicit WriteGuard(SharedLock& l) : lock(l) { lock.lock(); }
+		~WriteGuard() { lock.unlock(); }
+		WriteGuard(const WriteGuard&) = delete;
+		WriteGuard& operator=(const WriteGuard&) = delete;
+};
+
+inline SharedLock::SharedLock() : next_shard(0) {
+    pthread_rwlockattr_t attributes;
+    pthread_rwlockattr_init(&attributes);
+    pthread_rwlockattr_setkind_np(&attributes, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    for (int i = 0; i < RWLOCK_SHARDS; ++i) {
+        if (pthread_rwlock_init(&shards[i].lock, &attributes) != 0) { throw runtime_error("Cannot create a lock"); }
+    }
+    pthread_rwlockattr_destroy(&attributes);
+}
+
+inline SharedLock::~SharedLock() {
+    for (int i = 0; i < RWLOCK_SHARDS; ++i) { pthread_rwlock_destroy(&shards[i].lock); }
+}
+
+// Threads get their shards in turn the first time they read, and keep them
+inline int SharedLock::shard() {
+    static thread_local int mine = -1;
+    if (mine < 0) { mine = next_shard++ % RWLOCK_SHARDS; }
+    return mine;
+}
+
+inline void SharedLock::lock() {
+    for (int i = 0; i < RWLOCK_SHARDS; ++i) { pthread_rwlock_wrlock(&shards[i].lock); }
+}
+
+inline void SharedLock::unlock() {
+    for (int i = RWLOCK_SHARDS - 1; i >= 0; --i) { pthread_rwlock_unlock(&shards[i].lock); }
+}
+
+#endif
@@ -0,0 +1,253 @@
+#include<cstdlib>
+#include<cstring>
+#include<string>
+#include<cerrno>
+#include<stdexcept>
+#include<iostream>
+#include<csignal>
+#include<unistd.h>
+#include<sys/socket.h>
+#include<sys/un.h>
+#include<sys/epoll.h>
+
+#include "vfs.hpp"
+#include "server.hpp"
+
+using namespace std;
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1u << 28)		//older headers don't have it, the kernel ignores it before 4.5
+#endif
+
+//set by SIGINT and SIGTERM, every loop stops at its next wake up
+static volatile sig_atomic_t shutdown_signal = 0;
+
+static void on_shutdown(int) { shutdown_signal = 1; }
+
+Server::Server(VFS& v, const string& socket_path, int loop_count) : vfs(v), path(socket_path), listener(-1), loops(loop_count) {
+    if (loops <= 0) { loops = (int)thread::hardware_concurrency(); }
+    if (loops < 1) { loops = 1; }
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.length() >= sizeof(address.sun_path)) { throw runtime_error("Socket path is too long: " + path); }
+    memcpy(address.sun_path, path.c_str(), path.length() + 1);
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener < 0) { throw runtime_error("Cannot create a socket: " + string(strerror(errno))); }
+    //a socket left by a previous server would make bind fail
+    unlink(path.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0) {
+        string reason = strerror(errno);
+        ::close(listener);
+        throw runtime_error("Cannot listen on " + path + ": " + reason);
+    }
+}
+
+Server::~Server() {
+    if (listener >= 0) {
+        ::close(listener);
+        unlink(path.c_str());
+    }
+}
+
+void Server::run() {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_shutdown;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    //the calling thread is loop 0
+    thread* others = new thread[loops - 1];
+    for (int i = 1; i < loops; ++i) { others[i - 1] = thread(&Server::loop, this); }
+    loop();
+    for (int i = 0; i < loops - 1; ++i) { others[i].join(); }
+    delete[] others;
+    //the program ends right after the shutdown, remove the socket now
+    ::close(listener);
+    unlink(path.c_str());
+    listener = -1;
+    //save the tree as the exit of the console does, the sessions of the clients still connected go with it
+    Session* session = vfs.open_session(cout);
+    vfs.execute(*session, "exit", "", "");
+    vfs.close_session(session);
+}
+
+void Server::loop() {
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) { throw runtime_error("Cannot create an epoll set: " + string(strerror(errno))); }
+    //the listener is in every loop, EPOLLEXCLUSIVE wakes only one of them per new connection
+    epoll_event event;
+    event.events = EPOLLIN | EPOLLEXCLUSIVE;
+    event.data.ptr = nullptr;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listener, &event);
+
+    epoll_event events[SERVER_MAX_EVENTS];
+    while (!shutdown_signal) {
+        //wake up now and then to see if a shutdown signal came
+        int count = epoll_wait(epoll_fd, events, SERVER_MAX_EVENTS, 100);
+        for (int i = 0; i < count; ++i) {
+            Connection* connection = static_cast<Connection*>(events[i].data.ptr);
+            if (connection == nullptr) {
+                accept_all(epoll_fd);
+                continue;
+            }
+            //a connection that fails (e.g. out of memory) is closed, the others go on
+            try {
+                bool open = true;
+                if (!connection->closing && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) { open = receive(connection); }
+                //answer what was received, even when the client is gone or sent exit
+                if (!open) { connection->closing = true; }
+                if (!serve(epoll_fd, connection)) { close_connection(epoll_fd, connection); }
+            } catch (exception &e) {
+                cerr << "Closing a connection: " << e.what() << endl;
+                close_connection(epoll_fd, connection);
+            }
+        }
+    }
+    ::close(epoll_fd);
+}
+
+void Server::accept_all(int epoll_fd) {
+    while (true) {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        //EAGAIN: another loop took it, or there is nothing left to accept
+        if (fd < 0) { return; }
+        Connection* connection = nullptr;
+        try {
+            connection = new Connection();
+            connection->fd = fd;
+            connection->session = vfs.open_session(connection->output);
+        } catch (exception &e) {
+            cerr << "Refusing a connection: " << e.what() << endl;
+            delete connection;
+            ::close(fd);
+            continue;
+        }
+        connection->sent = 0;
+        connection->events = EPOLLIN;
+        connection->closing = false;
+        epoll_event event;
+        event.events = connection->events;
+        event.data.ptr = connection;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+bool Server::receive(Connection* connection) {
+    //read what is available, up to a full frame more than what is waiting to run
+    char buffer[SERVER_READ_CHUNK];
+    while (connection->input.length() < SERVER_MAX_INPUT) {
+        ssize_t count = read(connection->fd, buffer, sizeof(buffer));
+        if (count > 0) { connection->input.append(buffer, count); continue; }
+        if (count < 0 && errno == EINTR) { continue; }
+        if (count == 0 || errno != EAGAIN) { return false; }
+        break;
+    }
+    return true;
+}
+
+bool Server::serve(int epoll_fd, Connection* connection) {
+    //run and send in turns: the requests stop while too much output waits, and go on once it is sent
+    while (true) {
+        if (!run_requests(connection)) { return false; }
+        if (!flush(connection)) { return false; }
+        if (connection->sent < connection->pending.length() || !has_request(connection)) { break; }
+    }
+    bool done = connection->sent == connection->pending.length();
+    if (connection->closing && done && !has_request(connection)) { return false; }
+    //read while the output waiting is under the cap, wait for the socket while some is left
+    uint32_t events = 0;
+    if (!connection->closing && connection->pending.length() - connection->sent < SERVER_MAX_PENDING) { events |= EPOLLIN; }
+    if (!done) { events |= EPOLLOUT; }
+    if (events != connection->events) {
+        epoll_event event;
+        event.events = events;
+        event.data.ptr = connection;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection->fd, &event);
+        connection->events = events;
+    }
+    return true;
+}
+
+bool Server::has_request(Connection* connection) {
+    const string& input = connection->input;
+    return input.length() >= 4 && input.length() - 4 >= get_u32(input.data());
+}
+
+bool Server::run_requests(Connection* connection) {
+    //run every complete request, in order; a partial frame waits for the rest
+    string& input = connection->input;
+    size_t offset = 0;
+    string parameter1, parameter2;
+    while (input.length() - offset >= 4 && connection->pending.length() - connection->sent < SERVER_MAX_PENDING) {
+        uint32_t length = get_u32(input.data() + offset);
+        if (length > PROTOCOL_MAX_FRAME) { return false; }
+        if (input.length() - offset - 4 < length) { break; }
+        uint32_t id;
+        int opcode;
+        if (!decode_request(input.data() + offset + 4, length, id, opcode, parameter1, parameter2)) { return false; }
+        offset += 4 + length;
+        int status = STATUS_OK;
+        string payload;
+        if (opcode >= OP_COUNT) {
+            status = STATUS_ERROR;
+            payload = "Unknown opcode " + to_string(opcode);
+        } else if (opcode == OP_EXIT) {
+            //the other clients go on, the requests after exit are dropped with the connection
+            encode_response(connection->pending, id, status, "Closing the connection. Goodbye!\n");
+            connection->closing = true;
+            input.clear();
+            return true;
+        } else {
+            try {
+                vfs.execute(*connection->session, COMMANDS[opcode].name, parameter1, parameter2);
+                payload = connection->output.str();
+                //the client refuses larger frames, tell it why rather than sending one
+                if (payload.length() > PROTOCOL_MAX_RESPONSE) {
+                    status = STATUS_ERROR;
+                    payload = "The output of " + string(COMMANDS[opcode].name) + " is " + to_string(payload.length()) + " bytes, more than the "
+                              + to_string(PROTOCOL_MAX_RESPONSE) + " a response can carry. Narrow it down (e.g. ls --limit, a folder path) "
+                              "or run it in the console";
+                }
+            } catch (exception &e) {
+                status = STATUS_ERROR;
+                payload = e.what();
+            }
+            connection->output.str(string());
+            connection->output.clear();
+        }
+        encode_response(connection->pending, id, status, payload);
+    }
+    input.erase(0, offset);
+    return true;
+}
+
+bool Server::flush(Connection* connection) {
+    while (connection->sent < connection->pending.length()) {
+        ssize_t count = send(connection->fd, connection->pending.data() + connection->sent,
+                             connection->pending.length() - connection->sent, MSG_NOSIGNAL);
+        if (count > 0) { connection->sent += count; continue; }
+        if (count < 0 && errno == EINTR) { continue; }
+        if (count < 0 && errno == EAGAIN) {
+            //the socket is full, serve waits for it to be writable again. Drop what was sent once it is a cap
+            //worth, or the answers run meanwhile would keep growing the buffer
+            if (connection->sent >= SERVER_MAX_PENDING) {
+                connection->pending.erase(0, connection->sent);
+                connection->sent = 0;
+            }
+            return true;
+        }
+        return false;
+    }
+    connection->pending.clear();
+    connection->sent = 0;
+    return true;
+}
+
+void Server::close_connection(int epoll_fd, Connection* connection) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, connection->fd, nullptr);
+    ::close(connection->fd);
+    vfs.close_session(connection->session);
+    delete connection;
+}
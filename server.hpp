@@ -0,0 +1,60 @@
+#ifndef SERVER_H
+#define SERVER_H
+#include<cstdlib>
+#include<string>
+#include<sstream>
+#include<thread>
+#include<atomic>
+#include "vfs.hpp"
+#include "protocol.hpp"
+
+using namespace std;
+
+#define SERVER_READ_CHUNK (64 * 1024)	//bytes read from a connection at once
+#define SERVER_MAX_EVENTS 64			//events taken from epoll at once
+#define SERVER_MAX_INPUT (PROTOCOL_MAX_FRAME + 4)	//bytes waiting to run past which a connection is not read
+#define SERVER_MAX_PENDING (4 << 20)	//unsent response bytes past which a connection is not read
+
+//Server mode: serves the VFS on a Unix domain socket with the protocol of protocol.hpp. Every event loop
+//thread has its own epoll set and accepts connections from the shared listening socket, a connection then
+//stays on the loop that accepted it. Every connection is a session of the VFS, its requests run in order
+//and the read-only ones run alongside the requests of the other loops. exit only closes the connection that
+//sent it, the server stops on SIGINT or SIGTERM and then saves the tree like the exit of the console.
+class Server
+{
+	private:
+		struct Connection {
+			int fd;						//socket of the client
+			Session* session;			//session of the client in the VFS
+			ostringstream output;		//output of the command being run
+			string input;				//bytes received and not parsed yet
+			string pending;				//responses not sent yet
+			size_t sent;				//bytes of pending already sent
+			uint32_t events;			//events the loop waits for on the socket
+			bool closing;				//exit or the end of the input came, closed once the answers are sent
+		};
+
+		VFS& vfs;
+		string path;					//path of the socket
+		int listener;					//listening socket
+		int loops;						//number of event loop threads
+
+		void loop();					//Body of an event loop
+		void accept_all(int epoll_fd);	//Accept the waiting connections
+		bool receive(Connection* connection);	//Read what the client sent, false at the end of the input
+		bool serve(int epoll_fd, Connection* connection);	//Run the requests and send the answers, false when done
+		bool has_request(Connection* connection);	//True if a whole request waits to run
+		bool run_requests(Connection* connection);	//Run the whole requests received, false on a bad frame
+		bool flush(Connection* connection);	//Send the pending responses, false on error
+		void close_connection(int epoll_fd, Connection* connection);
+
+	public:
+		Server(VFS& v, const string& socket_path, int loop_count = 0);
+		~Server();
+		Server(const Server&) = delete;
+		Server& operator=(const Server&) = delete;
+
+		void run();						//Serve until SIGINT or SIGTERM
+};
+
+#endif
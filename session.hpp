@@ -0,0 +1,27 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include<ostream>
+using namespace std;
+
+class Inode;
+class HostScan;
+struct Snapshot;
+
+//State of one client of a VFS: its current and previous directories and where its output goes.
+//All the sessions share the tree of the VFS, a session itself is only used by one thread at a time.
+struct Session
+{
+	Inode* cwd;					//current directory
+	Inode* prev;				//previous directory for cd -, nullptr if none
+	Snapshot* snapshot;			//snapshot the current directory is in, nullptr for the tree
+	Snapshot* prev_snapshot;	//snapshot the previous directory is in
+	ostream* out;				//output of the commands run in the session
+	int slot;					//position of the session in the list of sessions of the VFS
+	HostScan* host_scan;		//host tree read by the running import before it took the tree lock
+
+	Session(Inode* root, ostream& output) : cwd(root), prev(nullptr), snapshot(nullptr), prev_snapshot(nullptr), out(&output), slot(-1),
+		host_scan(nullptr) {}
+};
+
+#endif
@@ -0,0 +1,232 @@
+#include<cstdlib>
+#include<cstring>
+#include<string>
+#include<stdint.h>
+#if defined(__x86_64__)
+#include<immintrin.h>
+#define SIMD_X86
+#endif
+
+#include "simd.hpp"
+
+using namespace std;
+
+// Scalar kernels, also used for the tails too short for a vector
+
+static inline bool name_char(unsigned char c) {
+    unsigned char lower = c | 0x20;
+    return (c >= '0' && c <= '9') || (lower >= 'a' && lower <= 'z');
+}
+
+static bool charset_scalar(const char* name, size_t length, size_t& dots) {
+    size_t count = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (name[i] == '.') { count++; }
+        else if (!name_char(name[i])) { return false; }
+    }
+    dots = count;
+    return true;
+}
+
+static bool equal_scalar(const char* a, const char* b, size_t length) {
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        if (x != y) { return false; }
+    }
+    for (; i < length; ++i) {
+        if (a[i] != b[i]) { return false; }
+    }
+    return true;
+}
+
+static bool contains_scalar(const char* text, size_t length, const char* literal, size_t literal_length) {
+    if (literal_length == 0) { return true; }
+    if (literal_length > length) { return false; }
+    for (size_t i = 0; i + literal_length <= length; ++i) {
+        if (text[i] == literal[0] && memcmp(text + i + 1, literal + 1, literal_length - 1) == 0) { return true; }
+    }
+    return false;
+}
+
+#ifdef SIMD_X86
+
+// SSE2 kernels, 16 bytes at a time. The comparisons are signed, so bytes from 0x80 up fail every range
+
+static inline __m128i sse2_in_range(__m128i v, char low, char high) {
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(low - 1)), _mm_cmpgt_epi8(_mm_set1_epi8(high + 1), v));
+}
+
+// Bytes that may appear in a name, with the periods in dot
+static inline __m128i sse2_name_bytes(__m128i v, __m128i& dot) {
+    __m128i digit = sse2_in_range(v, '0', '9');
+    __m128i alpha = sse2_in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+    dot = _mm_cmpeq_epi8(v, _mm_set1_epi8('.'));
+    return _mm_or_si128(_mm_or_si128(digit, alpha), dot);
+}
+
+static bool charset_sse2(const char* name, size_t length, size_t& dots) {
+    size_t count = 0, i = 0;
+    __m128i dot;
+    for (; i + 16 <= length; i += 16) {
+        __m128i ok = sse2_name_bytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(name + i)), dot);
+        if (_mm_movemask_epi8(ok) != 0xFFFF) { return false; }
+        count += __builtin_popcount(_mm_movemask_epi8(dot));
+    }
+    if (i < length) {
+        //the tail is copied into a block, the bytes past the end are masked out
+        char block[16];
+        memset(block, 0, sizeof(block));
+        memcpy(block, name + i, length - i);
+        unsigned int live = (1u << (length - i)) - 1;
+        __m128i ok = sse2_name_bytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block)), dot);
+        if ((_mm_movemask_epi8(ok) & live) != live) { return false; }
+        count += __builtin_popcount(_mm_movemask_epi8(dot) & live);
+    }
+    dots = count;
+    return true;
+}
+
+static bool equal_sse2(const char* a, const char* b, size_t length) {
+    if (length < 16) { return equal_scalar(a, b, length); }
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xFFFF) { return false; }
+    }
+    if (i == length) { return true; }
+    //the last block overlaps the previous one instead of reading past the end
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + length - 16));
+    __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + length - 16));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) == 0xFFFF;
+}
+
+// Compares the first and the last byte of the literal at 16 positions at once, and only the positions
+// where both match are compared in full
+static bool contains_sse2(const char* text, size_t length, const char* literal, size_t literal_length) {
+    if (literal_length < 2 || literal_length > length) { return contains_scalar(text, length, literal, literal_length); }
+    const __m128i first = _mm_set1_epi8(literal[0]);
+    const __m128i last = _mm_set1_epi8(literal[literal_length - 1]);
+    size_t i = 0;
+    for (; i + literal_length - 1 + 16 <= length; i += 16) {
+        __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + literal_length - 1));
+        unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last)));
+        while (mask != 0) {
+            size_t at = i + __builtin_ctz(mask);
+            if (memcmp(text + at + 1, literal + 1, literal_length - 2) == 0) { return true; }
+            mask &= mask - 1;
+        }
+    }
+    return contains_scalar(text + i, length - i, literal, literal_length);
+}
+
+// AVX2 kernels, the same 32 bytes at a time
+
+#define AVX2_TARGET __attribute__((target("avx2,popcnt")))
+
+AVX2_TARGET static inline __m256i avx2_in_range(__m256i v, char low, char high) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(low - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(high + 1), v));
+}
+
+AVX2_TARGET static inline __m256i avx2_name_bytes(__m256i v, __m256i& dot) {
+    __m256i digit = avx2_in_range(v, '0', '9');
+    __m256i alpha = avx2_in_range(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+    dot = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('.'));
+    return _mm256_or_si256(_mm256_or_si256(digit, alpha), dot);
+}
+
+AVX2_TARGET static bool charset_avx2(const char* name, size_t length, size_t& dots) {
+    size_t count = 0, i = 0;
+    __m256i dot;
+    for (; i + 32 <= length; i += 32) {
+        __m256i ok = avx2_name_bytes(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(name + i)), dot);
+        if ((unsigned int)_mm256_movemask_epi8(ok) != 0xFFFFFFFFu) { return false; }
+        count += __builtin_popcount((unsigned int)_mm256_movemask_epi8(dot));
+    }
+    if (i < length) {
+        char block[32];
+        memset(block, 0, sizeof(block));
+        memcpy(block, name + i, length - i);
+        unsigned int live = (1u << (length - i)) - 1;
+        __m256i ok = avx2_name_bytes(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(block)), dot);
+        if (((unsigned int)_mm256_movemask_epi8(ok) & live) != live) { return false; }
+        count += __builtin_popcount((unsigned int)_mm256_movemask_epi8(dot) & live);
+    }
+    dots = count;
+    return true;
+}
+
+AVX2_TARGET static bool equal_avx2(const char* a, const char* b, size_t length) {
+    if (length < 32) { return equal_sse2(a, b, length); }
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        if ((unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)) != 0xFFFFFFFFu) { return false; }
+    }
+    if (i == length) { return true; }
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + length - 32));
+    __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + length - 32));
+    return (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)) == 0xFFFFFFFFu;
+}
+
+AVX2_TARGET static bool contains_avx2(const char* text, size_t length, const char* literal, size_t literal_length) {
+    if (literal_length < 2 || literal_length > length) { return contains_scalar(text, length, literal, literal_length); }
+    const __m256i first = _mm256_set1_epi8(literal[0]);
+    const __m256i last = _mm256_set1_epi8(literal[literal_length - 1]);
+    size_t i = 0;
+    for (; i + literal_length - 1 + 32 <= length; i += 32) {
+        __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+        __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + literal_length - 1));
+        unsigned int mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last)));
+        while (mask != 0) {
+            size_t at = i + __builtin_ctz(mask);
+            if (memcmp(text + at + 1, literal + 1, literal_length - 2) == 0) { return true; }
+            mask &= mask - 1;
+        }
+    }
+    return contains_sse2(text + i, length - i, literal, literal_length);
+}
+
+#endif
+
+static const SimdKernels levels[] = {
+    { "scalar", charset_scalar, equal_scalar, contains_scalar },
+#ifdef SIMD_X86
+    { "sse2", charset_sse2, equal_sse2, contains_sse2 },
+    { "avx2", charset_avx2, equal_avx2, contains_avx2 },
+#endif
+};
+
+// Number of levels the CPU runs, the AVX2 one needs the CPU to support it
+static int supported_levels() {
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? 3 : 2;
+#else
+    return 1;
+#endif
+}
+
+// Picks the best supported level, or the one named by VFS_SIMD if it is supported
+static const SimdKernels* select_level() {
+    int count = supported_levels();
+    const char* forced = getenv("VFS_SIMD");
+    if (forced != nullptr) {
+        for (int i = 0; i < count; ++i) {
+            if (strcmp(levels[i].level, forced) == 0) { return &levels[i]; }
+        }
+    }
+    return &levels[count - 1];
+}
+
+const SimdKernels* simd = select_level();
+
+const SimdKernels* simd_levels(int& count) {
+    count = supported_levels();
+    return levels;
+}
@@ -0,0 +1,27 @@
+#ifndef SIMD_H
+#define SIMD_H
+#include<cstdlib>
+#include<string>
+
+using namespace std;
+
+//Kernels on names, in a scalar version and, on x86, SSE2 and AVX2 versions. The best level the CPU
+//supports is picked at startup; the environment variable VFS_SIMD (scalar, sse2 or avx2) can force a lower one
+struct SimdKernels
+{
+	const char* level;				//name of the level
+	bool (*charset)(const char* name, size_t length, size_t& dots);	//True if every byte is a letter, a digit or '.', with the periods counted
+	bool (*equal)(const char* a, const char* b, size_t length);		//True if the two byte ranges are equal
+	bool (*contains)(const char* text, size_t length, const char* literal, size_t literal_length);	//True if literal occurs in text
+};
+
+extern const SimdKernels* simd;		//kernels of the level in use
+const SimdKernels* simd_levels(int& count);		//Every level this CPU supports, lowest first
+
+inline bool name_chars_valid(const char* name, size_t length, size_t& dots) { return simd->charset(name, length, dots); }
+inline bool names_equal(const char* a, const char* b, size_t length) { return simd->equal(a, b, length); }
+inline bool contains_literal(const char* text, size_t length, const char* literal, size_t literal_length) {
+    return simd->contains(text, length, literal, literal_length);
+}
+
+#endif
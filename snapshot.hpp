@@ -0,0 +1,47 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include<cstdlib>
+#include<string>
+#include "vector.hpp"
+#include "hashmap.hpp"
+
+using namespace std;
+
+class Inode;
+
+//State of an Inode as a snapshot sees it, kept the first time the Inode changes after the snapshot.
+//The total and the parent are kept on any change, the children only when the children change
+struct Frozen
+{
+	Inode* parent;				//parent at the time of the snapshot, nullptr if the Inode wasn't in the tree
+	unsigned long long total;	//cached total at the time of the snapshot
+	Vector<Inode*> children;	//children at the time of the snapshot, when has_children
+	bool has_state;				//parent and total are kept
+	bool has_children;			//children are kept
+
+	Frozen() : parent(nullptr), total(0), has_state(false), has_children(false) {}
+};
+
+//Point-in-time view of the tree. Taking one copies nothing: the Inodes stay shared with the tree, and the
+//old state of an Inode is kept in the latest snapshot when it changes. A snapshot that didn't keep an Inode
+//sees it like the next snapshot does, or like the tree when no later snapshot kept it either
+struct Snapshot
+{
+	string name;						//name used in @name paths
+	unsigned int id;					//snapshots taken later have larger ids
+	int slot;							//position in the list of snapshots of the VFS
+	string taken;						//date it was taken
+	HashMap<Inode*, Frozen> frozen;		//old state of the Inodes changed after this snapshot and before the next
+	unsigned long long kept_children;	//children pointers kept in frozen
+
+	Snapshot(const string& n, unsigned int i, const string& t) : name(n), id(i), slot(-1), taken(t), kept_children(0) {}
+};
+
+//Subtree emptied from the bin while snapshots taken before may still see it
+struct Retired
+{
+	Inode* subtree;					//detached subtree
+	unsigned int seen_by;			//id of the latest snapshot when it was emptied, those up to it may see it
+};
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef TRIE_H
+#define TRIE_H
+
+#include<cstdlib>
+#include<cstring>
+#include<string>
+#include "pool.hpp"
+#include "simd.hpp"
+#include "vector.hpp"
+#include "hashmap.hpp"
+using namespace std;
+
+// True if a pattern contains a wildcard: '*' matches any run of characters, '?' any single character
+inline bool is_glob(const string& pattern) {
+    return pattern.find_first_of("*?") != string::npos;
+}
+
+// Matches a name against a glob pattern, backtracking only to the last '*' seen
+inline bool glob_match(const char* pattern, size_t plen, const char* name, size_t nlen) {
+    size_t p = 0, n = 0;
+    size_t star = (size_t)-1, resume = 0;
+    while (n < nlen) {
+        if (p < plen && (pattern[p] == '?' || pattern[p] == name[n])) { p++; n++; }
+        else if (p < plen && pattern[p] == '*') { star = p++; resume = n; }
+        else if (star != (size_t)-1) { p = star + 1; n = ++resume; }
+        else { return false; }
+    }
+    while (p < plen && pattern[p] == '*') { p++; }
+    return p == plen;
+}
+
+//A pattern with the cheap tests a name must pass before glob_match: the pattern has at least its characters
+//other than '*' in it, and the longest run of them without a wildcard, found with the vectorized search
+class GlobFilter
+{
+	private:
+		string pattern;
+		string literal;				//longest run of the pattern without a wildcard
+		size_t min_length;			//characters of the pattern other than '*'
+
+	public:
+		GlobFilter(const string& p) : pattern(p), min_length(0) {
+			size_t start = 0;
+			for (size_t i = 0; i <= pattern.length(); ++i) {
+				if (i == pattern.length() || pattern[i] == '*' || pattern[i] == '?') {
+					if (i - start > literal.length()) { literal = pattern.substr(start, i - start); }
+					start = i + 1;
+				}
+				if (i < pattern.length() && pattern[i] != '*') { min_length++; }
+			}
+		}
+		bool match(const char* name, size_t length) const {
+			return length >= min_length && contains_literal(name, length, literal.data(), literal.length())
+			       && glob_match(pattern.data(), pattern.length(), name, length);
+		}
+};
+
+//Index of a set of distinct names for pattern searches: a trie answering the literal prefix of a
+//pattern, and the names grouped by extension for patterns such as *.txt. Names are only ever added,
+//callers check that a name returned is still in use; the nodes of names no longer used stay until the
+//trie is cleared and filled again.
+class NameTrie
+{
+	private:
+		struct Node {
+			char c;					//character leading to this node
+			bool end;				//true if a name ends here
+			int child;				//first child, -1 if none
+			int sibling;			//next child of the same parent, -1 if none
+			int count;				//number of names in the subtree of this node
+			Name name;				//the name ending here
+		};
+		Vector<Node> nodes;						//nodes[0] is the root
+		HashMap<string, Vector<Name> > by_extension;	//names by the part after their last period
+		Vector<Name> all;						//every name, for patterns with neither prefix nor extension
+
+		int child(int node, char c) const;
+		void collect(int node, Vector<Name>& out) const;
+		bool narrow(const string& pattern, int& node, Vector<Name>*& group);
+
+	public:
+		NameTrie();
+
+		void insert(Name name);					//Add a name, it must not be in the trie yet
+		void clear();							//Remove every name and free the nodes
+		void match(const string& pattern, Vector<Name>& out);	//Append the names matching a glob pattern
+		int candidates(const string& pattern);	//Number of names match would test against a pattern
+		int size() const { return all.size(); }
+};
+
+inline NameTrie::NameTrie() {
+    clear();
+}
+
+inline void NameTrie::clear() {
+    nodes = Vector<Node>();
+    by_extension.clear();
+    all = Vector<Name>();
+    Node root;
+    root.c = 0;
+    root.end = false;
+    root.child = -1;
+    root.sibling = -1;
+    root.count = 0;
+    nodes.push_back(root);
+}
+
+inline int NameTrie::child(int node, char c) const {
+    for (int i = nodes[node].child; i != -1; i = nodes[i].sibling) {
+        if (nodes[i].c == c) { return i; }
+    }
+    return -1;
+}
+
+inline void NameTrie::insert(Name name) {
+    const char* chars = name.data();
+    size_t length = name.length();
+    int node = 0;
+    nodes[0].count++;
+    for (size_t i = 0; i < length; ++i) {
+        int next = child(node, chars[i]);
+        if (next == -1) {
+            Node added;
+            added.c = chars[i];
+            added.end = false;
+            added.child = -1;
+            added.sibling = nodes[node].child;
+            added.count = 0;
+            next = nodes.size();
+            nodes.push_back(added);
+            nodes[node].child = next;
+        }
+        node = next;
+        nodes[node].count++;
+    }
+    nodes[node].end = true;
+    nodes[node].name = name;
+    all.push_back(name);
+    // Group the name by its extension
+    const char* dot = static_cast<const char*>(memrchr(chars, '.', length));
+    if (dot != nullptr) { by_extension[string(dot + 1, chars + length - dot - 1)].push_back(name); }
+}
+
+// Appends every name ending in the subtree of a node
+inline void NameTrie::collect(int node, Vector<Name>& out) const {
+    Vector<int> stack;
+    stack.push_back(node);
+    while (!stack.empty()) {
+        int current = stack.back();
+        stack.pop_back();
+        if (nodes[current].end) { out.push_back(nodes[current].name); }
+        for (int i = nodes[current].child; i != -1; i = nodes[i].sibling) { stack.push_back(i); }
+    }
+}
+
+// Finds the subtree of the literal prefix of a pattern and the group of its literal extension (nullptr if it has
+// none), false when no name can match
+inline bool NameTrie::narrow(const string& pattern, int& node, Vector<Name>*& group) {
+    // The literal characters before the first wildcard lead to a single subtree of the trie
+    size_t literal = pattern.find_first_of("*?");
+    if (literal == string::npos) { literal = pattern.length(); }
+    // A literal extension after the last wildcard selects a single group of names
+    size_t dot = pattern.rfind('.');
+    bool has_extension = dot != string::npos && pattern.find_first_of("*?", dot) == string::npos;
+
+    node = 0;
+    for (size_t i = 0; i < literal && node != -1; ++i) { node = child(node, pattern[i]); }
+    if (node == -1) { return false; }
+    group = nullptr;
+    if (has_extension) {
+        group = by_extension.find(pattern.substr(dot + 1));
+        if (group == nullptr) { return false; }
+    }
+    return true;
+}
+
+inline int NameTrie::candidates(const string& pattern) {
+    int node;
+    Vector<Name>* group;
+    if (!narrow(pattern, node, group)) { return 0; }
+    return (group != nullptr && group->size() <= nodes[node].count) ? group->size() : nodes[node].count;
+}
+
+inline void NameTrie::match(const string& pattern, Vector<Name>& out) {
+    int node;
+    Vector<Name>* group;
+    if (!narrow(pattern, node, group)) { return; }
+    // Check whichever of the prefix subtree and the extension group holds fewer names
+    Vector<Name> candidates;
+    const Vector<Name>* source = &all;
+    if (group != nullptr && group->size() <= nodes[node].count) {
+        source = group;
+    } else if (node != 0) {
+        collect(node, candidates);
+        source = &candidates;
+    }
+    GlobFilter filter(pattern);
+    for (int i = 0; i < source->size(); ++i) {
+        const Name& name = (*source)[i];
+        if (filter.match(name.data(), name.length())) { out.push_back(name); }
+    }
+}
+
+#endif
@@ -2,30 +2,63 @@
 #define VECTOR_H
 
 #include<cstdlib>
+#include<cstring>
+#include<new>
+#include<utility>
+#include<type_traits>
 #include <stdexcept>
 #include "vfs.hpp"
 using namespace std;
 
-template <typename T>
+// Vector with room for N elements inside the object itself (small-buffer optimisation), so that
+// vectors of up to N elements never touch the heap. Trivially copyable elements are moved with
+// memcpy/realloc, other elements with their move constructors.
+template <typename T, int N = 4>
 class Vector
 {
+	static_assert(N > 0, "Vector needs room for at least one inline element");
+
 	private:
 		int v_size;        // current size of vector (number of elements in vector)
-    	int v_capacity;    // capacity of vector
-    	T* data;           // pointer to int(array) to store elements
+    	int v_capacity;    // capacity of vector, N while the elements are stored inline
+    	union {
+    		T* heap;                                    // pointer to the elements once they outgrow the inline buffer
+    		alignas(T) unsigned char local[N * sizeof(T)]; // inline buffer for the first N elements
+    	};
+
+    	static const bool trivial = is_trivially_copyable<T>::value;
+    	bool is_local() const { return v_capacity <= N; }
+    	T* data_ptr() { return is_local() ? reinterpret_cast<T*>(local) : heap; }
+    	const T* data_ptr() const { return is_local() ? reinterpret_cast<const T*>(local) : heap; }
+    	void grow(int min_capacity);                   // Make room for at least min_capacity elements
+    	void relocate(int new_capacity);               // Move the elements to a buffer of the given capacity
+    	void destroy_all();                            // Destroy the elements and release the heap buffer
+
 	public:
 		Vector(int cap=0);			//Constructor
+		Vector(const Vector& other);	//Copy constructor
+		Vector(Vector&& other);		//Move constructor
 		~Vector();					//Destructor
+		Vector& operator=(const Vector& other);	//Copy assignment
+		Vector& operator=(Vector&& other);		//Move assignment
 		int size() const;				//Return current size of vector
 		int capacity() const;			//Return capacity of vector
 		bool empty() const; 			//Rturn true if the vector is empty, False otherwise
 		const T& front();				//Returns reference of the first element in the vector
 		const T& back();				//Returns reference of the Last element in the vector
-		void push_back(T element);		//Add an element at the end of vector
-		void insert(int index, T element); //Add an element at the index 
+		void push_back(const T& element);	//Add an element at the end of vector
+		void push_back(T&& element);		//Add an element at the end of vector by moving it
+		template <typename... Args>
+		T& emplace_back(Args&&... args);	//Construct an element in place at the end of vector
+		void pop_back();					//Remove the last element
+		void insert(int index, T element); //Add an element at the index
 		void erase(int index);			//Removes an element from the index
+		void clear();					//Removes all the elements
+		void reserve(int cap);			//Make room for cap elements
 		T& operator[](int index);			//Returns the reference of an element at given index
+		const T& operator[](int index) const;	//Returns the reference of an element at given index
 		T& at(int index); 				//return reference of the element at given index
+		T* data() { return data_ptr(); }	//Returns the underlying array
 		void shrink_to_fit();			//Reduce vector capacity to fit its size
 		void display();
 
@@ -74,168 +107,322 @@ class Vector
         };
 
         // Function to get the iterator to the beginning of the vector
-        Iterator begin() {  
-            return Iterator(data);
+        Iterator begin() {
+            return Iterator(data_ptr());
         }
 
         // Function to get the iterator to the end of the vector (one past the last element)
         Iterator end() {
-            return Iterator(data + v_size);
+            return Iterator(data_ptr() + v_size);
         }
-        
+
 };
 
 // Constructor: Initializes a MyVector object with the specified capacity.
-template <typename T>
-Vector<T>::Vector(int cap) : v_size(0), v_capacity(cap), data(new T[cap]) {}
+template <typename T, int N>
+Vector<T, N>::Vector(int cap) : v_size(0), v_capacity(N) {
+    if (cap > N) { relocate(cap); }
+}
+
+// Copy constructor: copies every element into a buffer of its own.
+template <typename T, int N>
+Vector<T, N>::Vector(const Vector& other) : v_size(0), v_capacity(N) {
+    reserve(other.v_size);
+    const T* source = other.data_ptr();
+    T* target = data_ptr();
+    if (trivial) {
+        if (other.v_size > 0) { memcpy(static_cast<void*>(target), source, other.v_size * sizeof(T)); }
+    } else {
+        for (int i = 0; i < other.v_size; ++i) { new (target + i) T(source[i]); }
+    }
+    v_size = other.v_size;
+}
+
+// Move constructor: takes the heap buffer of the other vector, or moves its inline elements.
+template <typename T, int N>
+Vector<T, N>::Vector(Vector&& other) : v_size(0), v_capacity(N) {
+    *this = std::move(other);
+}
 
 // Destructor: Cleans up memory allocated for the vector.
-template <typename T>
-Vector<T>::~Vector() {
-    delete[] data;  // Release the allocated memory.
+template <typename T, int N>
+Vector<T, N>::~Vector() {
+    destroy_all();  // Release the allocated memory.
 }
 
-// Provides direct access to elements.
-template <typename T>
-T& Vector<T>::operator[ ](int i) {
-    return data[i]; 
+template <typename T, int N>
+Vector<T, N>& Vector<T, N>::operator=(const Vector& other) {
+    if (this != &other) {
+        Vector copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
 }
 
-// Appends an element to the end of the vector.
-template <typename T>
-void Vector<T>::push_back(T element) {
-    if (v_size >= v_capacity) {
-        // Increase capacity if necessary, by doubling it or setting it to 1 if it was 0.
-        int newCapacity = (v_capacity == 0) ? 1 : (v_capacity * 2);
-        T* newdata = new T[newCapacity];
+template <typename T, int N>
+Vector<T, N>& Vector<T, N>::operator=(Vector&& other) {
+    if (this == &other) { return *this; }
+    destroy_all();
+    if (other.is_local()) {
+        // Inline elements can't be stolen, move them one by one
+        T* source = other.data_ptr();
+        T* target = reinterpret_cast<T*>(local);
+        if (trivial) {
+            if (other.v_size > 0) { memcpy(static_cast<void*>(target), source, other.v_size * sizeof(T)); }
+        } else {
+            for (int i = 0; i < other.v_size; ++i) {
+                new (target + i) T(std::move(source[i]));
+                source[i].~T();
+            }
+        }
+        v_capacity = N;
+    } else {
+        heap = other.heap;
+        v_capacity = other.v_capacity;
+    }
+    v_size = other.v_size;
+    other.v_size = 0;
+    other.v_capacity = N;
+    return *this;
+}
 
-        // Copy existing elements to the new array.
+// Destroys the elements and frees the heap buffer, leaving an empty inline vector.
+template <typename T, int N>
+void Vector<T, N>::destroy_all() {
+    T* elements = data_ptr();
+    if (!trivial) {
+        for (int i = 0; i < v_size; ++i) { elements[i].~T(); }
+    }
+    if (!is_local()) {
+        if (trivial) { free(heap); } else { ::operator delete(heap); }
+    }
+    v_size = 0;
+    v_capacity = N;
+}
+
+// Moves the elements to a buffer of new_capacity elements (inline if it is at most N).
+template <typename T, int N>
+void Vector<T, N>::relocate(int new_capacity) {
+    if (new_capacity <= N) {
+        if (is_local()) { return; }
+        // Back to the inline buffer
+        T* old = heap;
+        T* target = reinterpret_cast<T*>(local);
+        if (trivial) {
+            if (v_size > 0) { memcpy(static_cast<void*>(target), old, v_size * sizeof(T)); }
+            free(old);
+        } else {
+            for (int i = 0; i < v_size; ++i) {
+                new (target + i) T(std::move(old[i]));
+                old[i].~T();
+            }
+            ::operator delete(old);
+        }
+        v_capacity = N;
+        return;
+    }
+    if (trivial) {
+        // Trivially copyable elements: realloc can often grow the block in place
+        T* new_data;
+        if (is_local()) {
+            new_data = static_cast<T*>(malloc(new_capacity * sizeof(T)));
+            if (new_data != nullptr && v_size > 0) { memcpy(static_cast<void*>(new_data), local, v_size * sizeof(T)); }
+        } else {
+            new_data = static_cast<T*>(realloc(static_cast<void*>(heap), new_capacity * sizeof(T)));
+        }
+        if (new_data == nullptr) { throw bad_alloc(); }
+        heap = new_data;
+    } else {
+        T* new_data = static_cast<T*>(::operator new(new_capacity * sizeof(T)));
+        T* old = data_ptr();
         for (int i = 0; i < v_size; ++i) {
-            newdata[i] = data[i];
+            new (new_data + i) T(std::move(old[i]));
+            old[i].~T();
         }
+        if (!is_local()) { ::operator delete(old); }
+        heap = new_data;
+    }
+    v_capacity = new_capacity;
+}
+
+// Grows the capacity geometrically so that at least min_capacity elements fit.
+template <typename T, int N>
+void Vector<T, N>::grow(int min_capacity) {
+    int newCapacity = v_capacity * 2;
+    if (newCapacity < min_capacity) { newCapacity = min_capacity; }
+    relocate(newCapacity);
+}
+
+// Provides direct access to elements.
+template <typename T, int N>
+T& Vector<T, N>::operator[ ](int i) {
+    return data_ptr()[i];
+}
+
+template <typename T, int N>
+const T& Vector<T, N>::operator[ ](int i) const {
+    return data_ptr()[i];
+}
 
-        data = newdata;
-        v_capacity = newCapacity; // Update capacity.
+// Appends an element to the end of the vector.
+template <typename T, int N>
+void Vector<T, N>::push_back(const T& element) {
+    emplace_back(element);
+}
+
+// Appends an element to the end of the vector by moving it.
+template <typename T, int N>
+void Vector<T, N>::push_back(T&& element) {
+    emplace_back(std::move(element));
+}
+
+// Constructs an element in place at the end of the vector.
+template <typename T, int N>
+template <typename... Args>
+T& Vector<T, N>::emplace_back(Args&&... args) {
+    if (v_size >= v_capacity) {
+        // The arguments may refer to an element of this vector, so build the new element first
+        T element(std::forward<Args>(args)...);
+        grow(v_size + 1);
+        new (data_ptr() + v_size) T(std::move(element));
+    } else {
+        new (data_ptr() + v_size) T(std::forward<Args>(args)...);
     }
-    // Add the new element.
-    data[v_size++] = element;
+    return data_ptr()[v_size++];
+}
+
+// Removes the last element.
+template <typename T, int N>
+void Vector<T, N>::pop_back() {
+    if (empty()) {
+        throw out_of_range("Vector is empty.");
+    }
+    v_size--;
+    data_ptr()[v_size].~T();
 }
 
 // Inserts an element at a given index.
-template <typename T>
-void Vector<T>::insert(int index, T element) {
+template <typename T, int N>
+void Vector<T, N>::insert(int index, T element) {
     if (index > v_size || index < 0) {
         throw out_of_range("Invalid index.");
     }
 
     // Check if a resize is needed.
     if (v_size >= v_capacity) {
-
-		if (v_capacity == 0) {
-			v_capacity = 1;
-		} else {
-			v_capacity = v_capacity*2;
-		}
-		T* newdata = new T[v_capacity];
-
-        // Copy elements to new memory space.
-        for (int i = 0; i < v_size; ++i) {
-            newdata[i] = data[i];
-        }
-
-        delete[] data;  // Free old memory.
-        data = newdata; // Point to the new memory.
+        grow(v_size + 1);
 	}
+	T* elements = data_ptr();
 	// Shift all elements from 'index' to the end one position to the right.
-    for (int i = v_size; i > index; --i) {
-        data[i] = data[i-1];
-    }
-
-    // Insert the new element at the given index.
-    data[index] = element;
+	if (trivial) {
+	    memmove(static_cast<void*>(elements + index + 1), elements + index, (v_size - index) * sizeof(T));
+	    new (elements + index) T(std::move(element));
+	} else if (index == v_size) {
+	    new (elements + index) T(std::move(element));
+	} else {
+	    new (elements + v_size) T(std::move(elements[v_size - 1]));
+	    for (int i = v_size - 1; i > index; --i) {
+	        elements[i] = std::move(elements[i - 1]);
+	    }
+	    // Insert the new element at the given index.
+	    elements[index] = std::move(element);
+	}
     v_size++;  // Increase the size of the vector.
 }
 
-template <typename T>
-void Vector<T>::erase(int index) {
+template <typename T, int N>
+void Vector<T, N>::erase(int index) {
     if (index < 0 || index >= v_size) {
         throw std::out_of_range("Index out of range");
     }
 
-    // If the vector holds pointers, delete the object pointed to
-
     // Shift elements down to fill the gap.
-    for (int i = index; i < v_size - 1; ++i) {
-        data[i] = data[i + 1];
+    T* elements = data_ptr();
+    if (trivial) {
+        memmove(static_cast<void*>(elements + index), elements + index + 1, (v_size - index - 1) * sizeof(T));
+    } else {
+        for (int i = index; i < v_size - 1; ++i) {
+            elements[i] = std::move(elements[i + 1]);
+        }
+        elements[v_size - 1].~T();
     }
-    
+
     // Reduce the size of the vector.
     v_size--;
 }
 
+// Removes all the elements, keeping the capacity.
+template <typename T, int N>
+void Vector<T, N>::clear() {
+    if (!trivial) {
+        T* elements = data_ptr();
+        for (int i = 0; i < v_size; ++i) { elements[i].~T(); }
+    }
+    v_size = 0;
+}
+
+// Makes room for cap elements without changing the size.
+template <typename T, int N>
+void Vector<T, N>::reserve(int cap) {
+    if (cap > v_capacity) {
+        relocate(cap);
+    }
+}
+
 // Accesses the element at a given index with bounds-checking.
-template <typename T>
-T& Vector<T>::at(int index) {
+template <typename T, int N>
+T& Vector<T, N>::at(int index) {
     if (index >= v_size || index < 0) {
         throw out_of_range("Invalid index.");
     }
 
-    return data[index];
+    return data_ptr()[index];
 }
 
 // Returns the first element.
-template <typename T>
-const T& Vector<T>::front() {
+template <typename T, int N>
+const T& Vector<T, N>::front() {
     if (empty()) {
         throw out_of_range("Vector is empty.");
     }
 
-    return data[0];
+    return data_ptr()[0];
 }
 
 // Returns the last element.
-template <typename T>
-const T& Vector<T>::back() {
+template <typename T, int N>
+const T& Vector<T, N>::back() {
     if (empty()) {
         throw out_of_range("Vector is empty.");
     }
 
-    return data[v_size - 1];
+    return data_ptr()[v_size - 1];
 }
 
 // Returns the number of elements.
-template <typename T>
-int Vector<T>::size() const {
+template <typename T, int N>
+int Vector<T, N>::size() const {
     return v_size;
 }
 
 // Returns the vector's capacity.
-template <typename T>
-int Vector<T>::capacity() const {
+template <typename T, int N>
+int Vector<T, N>::capacity() const {
     return v_capacity;
 }
 
 // Reduces the capacity of the vector to fit its size.
-template <typename T>
-void Vector<T>::shrink_to_fit() {
-    if (v_size < v_capacity) {
-        T* newData = new T[v_size];
-
-        // Copy elements to the new memory block.
-        for (int i = 0; i < v_size; ++i) {
-            newData[i] = data[i];
-        }
-
-        delete[] data;  // Free old memory.
-        data = newData; // Point to the new memory block.
-        v_capacity = v_size;
+template <typename T, int N>
+void Vector<T, N>::shrink_to_fit() {
+    if (v_size < v_capacity && !is_local()) {
+        relocate(v_size);
     }
 }
 
 // Checks if the vector is empty.
-template <typename T>
-bool Vector<T>::empty() const {
+template <typename T, int N>
+bool Vector<T, N>::empty() const {
     return v_size == 0;
 }
 
-#endif
\ No newline at end of file
+#endif
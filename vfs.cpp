@@ -1,9 +1,25 @@
 #include<iostream>
 #include<iomanip>
 #include<cstdlib>
+#include<cstring>
+#include<cctype>
 #include<string>
 #include<ctime>
 #include<fstream>
+#include<sstream>
+#include<cstdio>
+#include<deque>
+#include<memory>
+#include<vector>
+#include<algorithm>
+#include<chrono>
+#include<random>
+#include<unistd.h>
+#include<fcntl.h>
+#include<sys/stat.h>
+#if defined(__x86_64__)
+#include<x86intrin.h>
+#endif
 
 #include "vfs.hpp"
 #include "inode.hpp"
@@ -11,346 +27,931 @@
 #include "queue.hpp"
 
 
-#define MAXBIN 10
+#define MAXBIN 100000               //default maximum number of items in the bin
+#define MAXBIN_BYTES 0              //default maximum total size of the items in the bin (0 for no limit)
+#define VFS_FILE "vfs.dat"          //text file the tree is imported from when there is no image
+#define VFS_IMAGE "vfs.img"         //binary image the tree is opened from at startup and saved to at exit
+#define VFS_JOURNAL "vfs.log"       //changes made since the image was saved, replayed at startup
+#define JOURNAL_CHECKPOINT_BYTES (64 << 20)    //the image is saved and the journal emptied when it grows past this
+#define NAMES_COMPACT_MIN 4096      //names no longer used that a checkpoint leaves in the string pool at least
+#define LS_SCAN_MAX 64              //folders with more entries are listed by pattern through the name index
+#define LS_PAGE 100                 //rows of a page of ls --after without --limit
+#define LS_VIEWS 4                  //folders whose children ls paging keeps sorted by name
+#define LS_ROW_BUFFER (64 << 10)    //rows of ls are formatted into a buffer and written out when it grows past this
+#define IO_CHUNK (1 << 20)          //size of the buffered chunks used to read and write VFS_FILE
+#define BENCH_DEEP_LEVELS 1000      //default depth of the tree built by bench deep
+#define BENCH_DEEP_NAME "benchdeep" //folder of the root holding that tree while it is timed
+#define BENCH_CREATE_COUNT 1000000  //default number of files created by bench create
+#define BENCH_VECTOR_COUNT 10000000 //default number of ints pushed by bench vector
+#define BENCH_FANOUT_MAX 1000000    //default largest folder built by bench fanout
+#define BENCH_FANOUT_SCANS 1000     //lookups timed with a scan of the children, the way they were made before the index
+#define BENCH_CP_COUNT 1000000      //default number of Inodes of the subtree copied and moved by bench cp
+#define BENCH_CP_FANOUT 1000        //files in each folder of that subtree
+#define CHECK_FOLDER "vfscheck"     //folder of the root holding the Inodes made by the check command
+#define BENCH_JOURNAL_COUNT 100000  //default number of files created by bench journal, a hundredth of them in sync mode
 using namespace std;
 
-string VFS::currentTime() {
-    // Obtain current time
-    std::time_t t = std::time(nullptr);
-    // Convert to local time format
-    std::tm *tm_ptr = std::localtime(&t);
+// Strips the quotes around a pattern such as '*.txt', the command line doesn't interpret them
+static string unquote(const string& text) {
+    if (text.length() >= 2 && (text[0] == '\'' || text[0] == '"') && text[text.length() - 1] == text[0]) {
+        return text.substr(1, text.length() - 2);
+    }
+    return text;
+}
+
+// Reads a date as day-month-year (the year possibly on two digits, for 20yy) into the microseconds of its
+// local midnight. The previous date is remembered, since the dates of a file being loaded are mostly equal
+static bool parse_date(const char* text, size_t length, int64_t& created) {
+    thread_local string last_text;
+    thread_local int64_t last_created = 0;
+    if (!last_text.empty() && last_text.length() == length && memcmp(last_text.data(), text, length) == 0) {
+        created = last_created;
+        return true;
+    }
+    int fields[3] = {0, 0, 0};
+    size_t i = 0, year_digits = 0;
+    for (int f = 0; f < 3; ++f) {
+        size_t start = i;
+        for (; i < length && isdigit((unsigned char)text[i]); ++i) { fields[f] = fields[f] * 10 + (text[i] - '0'); }
+        if (i == start || i - start > 4 || (f < 2 && (i == length || text[i++] != '-'))) { return false; }
+        year_digits = i - start;
+    }
+    if (i != length || fields[0] < 1 || fields[0] > 31 || fields[1] < 1 || fields[1] > 12) { return false; }
+    tm day;
+    memset(&day, 0, sizeof(day));
+    day.tm_mday = fields[0];
+    day.tm_mon = fields[1] - 1;
+    day.tm_year = (year_digits <= 2 ? 2000 + fields[2] : fields[2]) - 1900;
+    day.tm_isdst = -1;
+    created = (int64_t)mktime(&day) * 1000000;
+    last_text.assign(text, length);
+    last_created = created;
+    return true;
+}
+
+// Formats a creation time as day-month-year in local time. The text of the last day formatted is kept
+// with the bounds of that day, so only the first time of another day goes through localtime_r and mktime
+static const string& format_date(int64_t created) {
+    thread_local string text;
+    thread_local int64_t day_begin = 1, day_end = 0;
+    if (created >= day_begin && created < day_end) { return text; }
+    time_t seconds = (time_t)(created / 1000000 - (created % 1000000 < 0 ? 1 : 0));
+    tm day;
+    localtime_r(&seconds, &day);
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "%d-%d-%d", day.tm_mday, day.tm_mon + 1, day.tm_year + 1900);
+    text.assign(buffer, length);
+    day.tm_hour = day.tm_min = day.tm_sec = 0;
+    day.tm_isdst = -1;
+    day_begin = (int64_t)mktime(&day) * 1000000;
+    day.tm_mday++;
+    day.tm_isdst = -1;
+    day_end = (int64_t)mktime(&day) * 1000000;
+    return text;
+}
+
+//Function to get the children of the current folder of a session sorted by name, from the view of one of the
+//last LS_VIEWS folders paged through or sorted now in place of the oldest. The caller holds views_lock
+Vector<Inode*>& VFS::sorted_children(Session& session, Vector<Inode*>& children) {
+    unsigned int snapshot = (session.snapshot != nullptr) ? session.snapshot->id : 0;
+    unsigned long long version = (session.snapshot != nullptr) ? 0 : tree_version;
+    for (int i = 0; i < sorted_views.size(); ++i) {
+        SortedView& view = sorted_views[i];
+        if (view.folder == session.cwd && view.snapshot == snapshot && view.version == version) { return view.children; }
+    }
+    if (sorted_views.size() < LS_VIEWS) { sorted_views.push_back(SortedView()); }
+    SortedView& view = sorted_views[next_view];
+    next_view = (next_view + 1) % LS_VIEWS;
+    view.folder = session.cwd;
+    view.snapshot = snapshot;
+    view.version = version;
+    view.children = children;
+    sort(view.children.data(), view.children.data() + view.children.size(),
+         [](Inode* a, Inode* b) { return strcmp(a->name.c_str(), b->name.c_str()) < 0; });
+    return view.children;
+}
 
-    // tm_mon gives month from 0 to 11, add 1 for a human-readable format
-    int month = tm_ptr->tm_mon + 1;
-    int day = tm_ptr->tm_mday;
-    // tm_year gives years since 1900
-    int year = tm_ptr->tm_year + 1900;
+// Appends a field right-aligned in width columns, like setw(width) (a longer field is not cut)
+static void put_field(string& buffer, const char* text, size_t length, size_t width) {
+    if (length < width) { buffer.append(width - length, ' '); }
+    buffer.append(text, length);
+}
+
+// Appends a row of ls: type, name in name_width columns, date in 15, size in 10, in the layout setw gave
+void VFS::put_row(string& buffer, Inode* inode, size_t name_width) {
+    if (inode->type == File) { buffer.append("File", 4); } else { buffer.append("dir", 3); }
+    put_field(buffer, inode->name.data(), inode->name.length(), name_width);
+    const string& date = format_date(inode->created);
+    put_field(buffer, date.data(), date.length(), 15);
+    char digits[24];
+    char* end = digits + sizeof(digits);
+    char* at = end;
+    unsigned long long size = inode->size;
+    do { *--at = '0' + size % 10; size /= 10; } while (size > 0);
+    put_field(buffer, at, end - at, 10);
+    buffer.append("bytes\n", 6);
+}
 
-    //Combine all of them in 1 string to return it
-    string currentTime = to_string(day) + "-" + to_string(month) + "-" + to_string(year); 
+// Prints rows of ls, formatted into one buffer written out every LS_ROW_BUFFER bytes
+void VFS::print_rows(ostream& out, Inode* const* rows, int count, size_t name_width) {
+    string buffer;
+    buffer.reserve(LS_ROW_BUFFER + 256);
+    for (int i = 0; i < count; ++i) {
+        put_row(buffer, rows[i], name_width);
+        if (buffer.length() >= LS_ROW_BUFFER) {
+            out.write(buffer.data(), buffer.length());
+            buffer.clear();
+        }
+    }
+    out.write(buffer.data(), buffer.length());
+    out.flush();
+}
 
-    return currentTime;
+//Function to return the current time in microseconds since the epoch, it is only formatted when printed
+int64_t VFS::currentTime() {
+    return chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
 }
 
 bool VFS::correct_name(string name) {
-    if (name.length() == 0) { return false; }
-    bool has_extension = false;
-    for (size_t i = 0; i < name.length(); ++i) {
-        if (name[i] == '.') {
-            // Ensure that the period is not at the start or end and there's only one
-            if (has_extension || i == 0 || i == name.length() - 1) {
-                return false;
+    return correct_name(name.data(), name.length());
+}
+
+bool VFS::correct_name(const char* name, size_t length) {
+    if (length == 0) { return false; }
+    // Every character must be alphanumeric or a period, checked a vector at a time
+    size_t dots;
+    if (!name_chars_valid(name, length, dots)) { return false; }
+    // Ensure that there's at most one period and that it is not at the start or end
+    return dots == 0 || (dots == 1 && name[0] != '.' && name[length - 1] != '.');
+}
+
+bool VFS::repeated_name(Inode* folder, string name) {
+    //Look the name up in the hash index of the folder
+    return lookup(folder, name) != nullptr;
+}
+
+//Function to intern a name, adding it to the pattern index the first time it is seen. The caller holds pool_lock,
+//readers may be materializing folders at the same time
+Name VFS::intern(const char* name, size_t length) {
+    int before = names.size();
+    Name interned = names.intern(name, length);
+    if (names.size() != before) { patterns.insert(interned); }
+    return interned;
+}
+
+//Function to create an Inode in the slab allocator, with its name interned
+Inode* VFS::new_inode(const string& name, Inode* parent, bool type, unsigned int size, int64_t created) {
+    lock_guard<mutex> guard(pool_lock);
+    return make_inode(intern(name.data(), name.length()), parent, type, size, created, false);
+}
+
+//Function to create an Inode and index its name, the caller holds pool_lock. Every Inode is made here. No
+//snapshot has seen a new Inode, so none needs its old state; one read from the image was in the tree before
+//the snapshots were taken, so its first change must still be kept for them
+Inode* VFS::make_inode(Name name, Inode* parent, bool type, unsigned int size, int64_t created, bool from_image) {
+    Inode* inode = inodes.create(name, parent, type, size, created);
+    index_name(inode);
+    if (!from_image) {
+        inode->frozen_at = snapshot_clock;
+        inode->children_frozen_at = snapshot_clock;
+    }
+    return inode;
+}
+
+//Function to add an Inode to the name index, the caller holds pool_lock
+void VFS::index_name(Inode* inode) {
+    Vector<Inode*>& same = by_name[inode->name];
+    inode->name_slot = same.size();
+    same.push_back(inode);
+}
+
+//Function to remove an Inode from the name index, the caller holds pool_lock
+void VFS::unindex_name(Inode* inode) {
+    Vector<Inode*>* same = by_name.find(inode->name);
+    if (same == nullptr) { return; }
+    //move the last Inode with this name into the hole
+    Inode* last = (*same)[same->size() - 1];
+    (*same)[inode->name_slot] = last;
+    last->name_slot = inode->name_slot;
+    same->pop_back();
+    if (same->empty()) { by_name.erase(inode->name); }
+}
+
+//Function to free a detached subtree, once no snapshot can see it anymore
+void VFS::reclaim(Inode* inode) {
+    //the Inodes of the subtree may be reused, no cached path may point at them (emptybin and the bin limits)
+    path_cache.invalidate();
+    //the snapshots taken before may still see the subtree, it waits for them to be dropped
+    if (!snapshots.empty()) {
+        Retired subtree = { inode, snapshots[snapshots.size() - 1]->id };
+        retired.push_back(subtree);
+        return;
+    }
+    free_subtree(inode);
+}
+
+//Function to hand a detached subtree to the background reclaimer, which gives its Inodes back to the slab allocator
+void VFS::free_subtree(Inode* inode) {
+    lock_guard<mutex> guard(reclaim_lock);
+    //the thread is only started the first time there is something to free
+    if (!reclaimer.joinable()) { reclaimer = thread(&VFS::reclaim_loop, this); }
+    reclaim_queue.push_back(inode);
+    reclaim_ready.notify_one();
+}
+
+//Body of the reclaimer thread: frees the queued subtrees in batches, so that the command loop only
+//waits for the slab allocator for the time of one batch
+void VFS::reclaim_loop() {
+    const int BATCH = 4096;
+    Vector<Inode*> stack;       //Inodes of the current subtree still to visit
+    Vector<Inode*> batch;       //visited Inodes waiting to be destroyed
+    while (true) {
+        Inode* subtree;
+        {
+            unique_lock<mutex> guard(reclaim_lock);
+            reclaim_busy = false;
+            while (reclaim_queue.empty() && !reclaim_stop) { reclaim_ready.wait(guard); }
+            if (reclaim_stop) { return; }
+            subtree = reclaim_queue.back();
+            reclaim_queue.pop_back();
+            reclaim_busy = true;
+        }
+        //the subtree is detached, so nobody else reads it while it is walked
+        stack.push_back(subtree);
+        while (!stack.empty()) {
+            Inode* inode = stack.back();
+            stack.pop_back();
+            for (Vector<Inode*>::Iterator it = inode->children.begin(); it != inode->children.end(); ++it) {
+                stack.push_back(*it);
+            }
+            batch.push_back(inode);
+            if (batch.size() == BATCH || stack.empty()) {
+                unsigned long long bytes = 0;
+                lock_guard<mutex> guard(pool_lock);
+                for (int i = 0; i < batch.size(); ++i) {
+                    Inode* dead = batch[i];
+                    bytes += sizeof(Inode) + dead->index.bytes();
+                    if (dead->children.capacity() > 4) { bytes += dead->children.capacity() * sizeof(Inode*); }
+                    //a folder that was never materialized doesn't need the image anymore
+                    if (dead->image_record >= 0) { lazy_folders--; }
+                    //the children are destroyed later, cut them off so that find never walks up into a freed slot
+                    for (int c = 0; c < dead->children.size(); ++c) { dead->children[c]->parent = nullptr; }
+                    unindex_name(dead);
+                    inodes.destroy(dead);
+                }
+                reclaimed_nodes += batch.size();
+                reclaimed_bytes += bytes;
+                batch.clear();
             }
-            has_extension = true;
-        } else if (!std::isalnum(static_cast<unsigned char>(name[i]))) {
-            // If it's not a period, it must be alphanumeric
-            return false;
         }
     }
-    return true;
 }
 
-bool VFS::repeated_name(string name) {
-    bool repeated = false;
-    //Compare the name to all of the names exists under the same folder
-    for (Vector<Inode*>::Iterator it = curr_inode->children.begin(); it != curr_inode->children.end(); ++it ){
-        if((*it)->name == name) {
-            repeated = true;
-            break; // If a match is found, no need to continue checking
+//Destructor: stops the reclaimer, the Inodes it didn't free yet go with the slab allocator
+VFS::~VFS() {
+    {
+        lock_guard<mutex> guard(reclaim_lock);
+        reclaim_stop = true;
+        reclaim_ready.notify_one();
+    }
+    if (reclaimer.joinable()) { reclaimer.join(); }
+    for (int i = 0; i < snapshots.size(); ++i) { delete snapshots[i]; }
+}
+
+//Function to check if a node is the ancestor itself or somewhere below it
+bool VFS::is_inside(Inode* node, Inode* ancestor) const {
+    for (Inode* temp = node; temp != nullptr; temp = temp->parent) {
+        if (temp == ancestor) { return true; }
+    }
+    return false;
+}
+
+//Function to find the child of a folder by its name, nullptr if there is none
+Inode* VFS::lookup(Inode* folder, const string& name) {
+    expand(folder);
+    return folder->index.find(name);
+}
+
+Inode* VFS::lookup(Inode* folder, const char* name, size_t length) {
+    expand(folder);
+    return folder->index.find(name, length);
+}
+
+//Function to add a child to a folder, keeping the children vector and the name index in sync
+void VFS::link_child(Inode* folder, Inode* child) {
+    expand(folder);
+    freeze_children(folder);
+    freeze(child);
+    insert_child(folder, child);
+    child->parent = folder;
+    //the whole subtree of the child is now counted in the folder and its ancestors
+    add_total(folder, child->total);
+}
+
+//Function to put a child in the children vector and the name index of a folder, remembering its position in
+//the vector. Nothing else: link_child also keeps the snapshots and the totals up to date
+void VFS::insert_child(Inode* folder, Inode* child) {
+    child->child_slot = folder->children.size();
+    folder->children.push_back(child);
+    folder->index.insert(child);
+}
+
+//Function to remove a child from a folder, keeping the children vector and the name index in sync. The last
+//child moves into its place, so the order of a folder changes with removals (ls sort name and paging sort)
+void VFS::unlink_child(Inode* folder, Inode* child) {
+    expand(folder);
+    freeze_children(folder);
+    freeze(child);
+    Inode* last = folder->children[folder->children.size() - 1];
+    folder->children[child->child_slot] = last;
+    last->child_slot = child->child_slot;
+    folder->children.pop_back();
+    child->child_slot = -1;
+    folder->index.erase(child);
+    child->parent = nullptr;
+    add_total(folder, -(long long)child->total);
+    //the cached paths through the child lead nowhere now (rm and mv both come through here)
+    path_cache.invalidate();
+}
+
+//Function to add a (possibly negative) size difference to the cached totals of a folder and all its ancestors
+void VFS::add_total(Inode* folder, long long delta) {
+    //every change of the tree comes through here, the flat copy of the tree is out of date
+    tree_version++;
+    for (Inode* temp = folder; temp != nullptr; temp = temp->parent) {
+        freeze(temp);
+        temp->total += delta;
+    }
+}
+
+//Function to keep the total and the parent of an Inode in the latest snapshot before they change,
+//unless it kept them already. Only the first change after a snapshot copies anything
+void VFS::freeze(Inode* inode) {
+    if (snapshots.empty()) { return; }
+    Snapshot* latest = snapshots[snapshots.size() - 1];
+    if (inode->frozen_at >= latest->id) { return; }
+    Frozen& state = latest->frozen[inode];
+    state.parent = inode->parent;
+    state.total = inode->total;
+    state.has_state = true;
+    inode->frozen_at = latest->id;
+}
+
+//Function to keep the children of a materialized folder in the latest snapshot before they change
+void VFS::freeze_children(Inode* folder) {
+    if (snapshots.empty()) { return; }
+    Snapshot* latest = snapshots[snapshots.size() - 1];
+    if (folder->children_frozen_at >= latest->id) { return; }
+    Frozen& state = latest->frozen[folder];
+    state.children = folder->children;
+    state.has_children = true;
+    latest->kept_children += folder->children.size();
+    folder->children_frozen_at = latest->id;
+}
+
+//Function to get the state a snapshot sees for an Inode, if the Inode changed since: the state kept by the
+//snapshot itself or by the first later snapshot that kept it. nullptr if the snapshot sees the Inode as it is
+Frozen* VFS::frozen_state(Snapshot* view, Inode* inode, bool children) {
+    for (int i = view->slot; i < snapshots.size(); ++i) {
+        Frozen* state = snapshots[i]->frozen.find(inode);
+        if (state != nullptr && (children ? state->has_children : state->has_state)) { return state; }
+    }
+    return nullptr;
+}
+
+//Functions to read an Inode as a snapshot sees it, or as it is when view is nullptr
+Vector<Inode*>& VFS::children_in(Snapshot* view, Inode* folder) {
+    Frozen* state = (view != nullptr) ? frozen_state(view, folder, true) : nullptr;
+    return (state != nullptr) ? state->children : children_of(folder);
+}
+
+unsigned long long VFS::total_in(Snapshot* view, Inode* inode) {
+    Frozen* state = (view != nullptr) ? frozen_state(view, inode, false) : nullptr;
+    return (state != nullptr) ? state->total : inode->total;
+}
+
+Inode* VFS::parent_in(Snapshot* view, Inode* inode) {
+    Frozen* state = (view != nullptr) ? frozen_state(view, inode, false) : nullptr;
+    return (state != nullptr) ? state->parent : inode->parent;
+}
+
+Inode* VFS::lookup_in(Snapshot* view, Inode* folder, const string& name) {
+    Frozen* state = (view != nullptr) ? frozen_state(view, folder, true) : nullptr;
+    if (state == nullptr) { return lookup(folder, name); }
+    //the old children have no index of their own
+    for (int i = 0; i < state->children.size(); ++i) {
+        if (state->children[i]->name == name) { return state->children[i]; }
+    }
+    return nullptr;
+}
+
+//Function to follow a path of names from base in a snapshot, "/" alone is the root of the snapshot
+Inode* VFS::node_in(Snapshot* view, Inode* base, const string& path) {
+    Inode* node = (!path.empty() && path[0] == '/') ? root : base;
+    size_t start = 0;
+    while (start <= path.length()) {
+        size_t end = path.find('/', start);
+        if (end == string::npos) { end = path.length(); }
+        if (end > start) {
+            node = lookup_in(view, node, path.substr(start, end - start));
+            if (node == nullptr) { return nullptr; }
         }
+        start = end + 1;
     }
-    return repeated;
+    return node;
 }
 
+//Function to return the path of an Inode in a snapshot, as @name/path
+string VFS::path_in(Snapshot* view, Inode* inode) {
+    if (view == nullptr) { return pwd(inode); }
+    //collect the Inodes up to the root, then build the path once from the top
+    Vector<Inode*> chain;
+    size_t length = view->name.length() + 1;
+    for (Inode* temp = inode; temp != root && temp != nullptr; temp = parent_in(view, temp)) {
+        chain.push_back(temp);
+        length += temp->name.length() + 1;
+    }
+    string path;
+    path.reserve(length);
+    path += '@';
+    path += view->name;
+    for (int i = chain.size() - 1; i >= 0; --i) {
+        path += '/';
+        path.append(chain[i]->name.data(), chain[i]->name.length());
+    }
+    return path;
+}
 
 VFS::VFS() {
     //initialize the root of the VF
-    root = new Inode("root", nullptr, Folder, 0, currentTime());
-    //create a vector to store the children of the root
-    root->children = Vector<Inode*>();
-    //initialize current and prev inodes
-    curr_inode = root;
-    prev_inode = nullptr;
-    //Create the bins to store the information of a deleted inode
-    Queue<string> bin_paths(MAXBIN);
-    Queue<Inode*> bin(MAXBIN);
-    Queue<Inode*> bin_parents(MAXBIN);
-}
-
-void VFS::help() {
+    snapshot_clock = 0;
+    tree_version = 0;
+    next_view = 0;
+    root = new_inode("root", nullptr, Folder, 0, currentTime());
+    lazy_folders = 0;
+    reclaim_busy = false;
+    reclaim_stop = false;
+    reclaimed_nodes = 0;
+    reclaimed_bytes = 0;
+    checkpoint_id = 0;
+    last_record = 0;
+    //limits of the bin, the oldest items are purged beyond them
+    bin_max_items = MAXBIN;
+    bin_max_bytes = MAXBIN_BYTES;
+    //restore the tree saved by the previous session, if there is one, otherwise import the text file
+    bool opened = false;
+    try {
+        opened = open_image(VFS_IMAGE);
+    } catch (exception &e) {
+        cout << "Exception: " << e.what() << endl;
+    }
+    if (!opened) { load(VFS_FILE); }
+    //redo the changes made after the image was saved, in a session of its own whose output is dropped
+    ostream discard(nullptr);
+    Session replaying(root, discard);
+    unsigned long long failed = 0;
+    unsigned long long replayed = 0;
+    try {
+        replayed = journal.open(VFS_JOURNAL, checkpoint_id, [&](const JournalRecord& change) {
+            try {
+                replay(replaying, change);
+            } catch (exception &e) {
+                failed++;
+            }
+        });
+    } catch (exception &e) {
+        //a read-only folder or a full disk: the tree is still usable, only without the journal
+        cout << "Exception: " << e.what() << endl;
+        cout << "Starting with the journal off, use checkpoint to save the tree or journal async to try again" << endl;
+        journal.set_mode(JOURNAL_OFF);
+    }
+    if (replayed > 0) {
+        cout << "Replayed " << replayed << " change(s) from " << VFS_JOURNAL;
+        if (failed > 0) { cout << ", " << failed << " of them could not be applied"; }
+        cout << endl;
+    }
+}
+
+//Function to start a session in the root folder, writing the output of its commands to out
+Session* VFS::open_session(ostream& out) {
+    WriteGuard guard(tree_lock);
+    Session* session = new Session(root, out);
+    session->slot = sessions.size();
+    sessions.push_back(session);
+    return session;
+}
+
+//Function to end a session
+void VFS::close_session(Session* session) {
+    WriteGuard guard(tree_lock);
+    //move the last session into the hole
+    Session* last = sessions[sessions.size() - 1];
+    sessions[session->slot] = last;
+    last->slot = session->slot;
+    sessions.pop_back();
+    delete session;
+}
+
+//Function to run a command of a session. The commands that only read the tree (and the state of the session)
+//hold the tree lock for reading and run alongside each other, the others hold it for writing. The commands
+//and their kinds are the list of commands.hpp, shared with the protocol of the server.
+//Returns false after exit, once the tree is saved
+bool VFS::execute(Session& session, const string& command, const string& parameter1, const string& parameter2) {
+    int opcode = opcode_of(command);
+    if (opcode < 0) {
+        *session.out << command << ": command not found" << endl;
+        return true;
+    }
+    //Commands that only read
+    if (opcode == OP_HELP)				{ help(session); return true; }
+    if (COMMANDS[opcode].kind == COMMAND_READ) {
+        ReadGuard guard(tree_lock);
+        return dispatch(session, (Opcode)opcode, parameter1, parameter2);
+    }
+    //Commands that change the tree, the bin or the settings. import reads the host tree before it takes
+    //the tree lock, the other sessions only wait for the linking
+    unique_ptr<HostScan> scan;
+    if (opcode == OP_IMPORT) { scan.reset(scan_host(parameter1)); }
+    session.host_scan = scan.get();
+    unsigned long long end;
+    bool sync;
+    {
+        WriteGuard guard(tree_lock);
+        last_record = 0;
+        //the folders of a snapshot are only for reading
+        if (session.snapshot != nullptr && COMMANDS[opcode].kind == COMMAND_CHANGE) {
+            throw runtime_error("Snapshots are read-only, cd to a folder of the tree to change it");
+        }
+        if (!dispatch(session, (Opcode)opcode, parameter1, parameter2)) { return false; }
+        release_image();
+        end = last_record;
+        sync = journal.mode() == JOURNAL_SYNC;
+        //keep the journal short, the replay at startup reads all of it
+        if (end > 0 && journal.size() > JOURNAL_CHECKPOINT_BYTES) { save_checkpoint(); }
+    }
+    //in sync mode the command returns once its change is on disk. The tree lock is released first, so the
+    //changes of the other sessions join the same sync
+    if (end > 0 && sync) { journal.wait(end); }
+    return true;
+}
+
+//Function to call the method of a command, under the lock execute took for its kind. Every opcode has a
+//case and there is no default, so a command added to commands.hpp and not here is a compiler warning
+bool VFS::dispatch(Session& session, Opcode opcode, const string& parameter1, const string& parameter2) {
+    switch (opcode) {
+        case OP_HELP:			help(session); break;
+        case OP_PWD:			*session.out << pwd(session) << endl; break;
+        case OP_LS:				ls(session, parameter1, parameter2); break;
+        case OP_CD:				cd(session, parameter1); break;
+        case OP_SIZE:			size(session, parameter1, parameter2); break;
+        case OP_SHOWBIN:		showbin(session); break;
+        case OP_FIND:			find(session, parameter1, parameter2); break;
+        case OP_STATS:			stats(session); break;
+        case OP_EXPORT:			export_dat(session, parameter1); break;
+        case OP_MKDIR:			mkdir(session, parameter1); break;
+        case OP_TOUCH:
+            if (parameter2.empty()) {
+                throw runtime_error("Cannot create a file without specifying its size. Please enter the command in the form of 'touch file_name size'");
+            }
+            touch(session, parameter1, stoi(parameter2));
+            break;
+        case OP_RM:				rm(session, parameter1); break;
+        case OP_EMPTYBIN:		emptybin(session); break;
+        case OP_BINLIMIT:		binlimit(session, parameter1, parameter2); break;
+        case OP_EXIT:			exit(session); return false;
+        case OP_MV:				mv(session, parameter1, parameter2); break;
+        case OP_CP:				cp(session, parameter1, parameter2); break;
+        case OP_RECOVER:		recover(session, parameter1); break;
+        case OP_IMPORT:			import(session, parameter2); break;
+        case OP_THREADS:		threads(session, parameter1); break;
+        case OP_BENCH:			bench(session, parameter1, parameter2); break;
+        case OP_CHECK:			check(session, parameter1); break;
+        case OP_CHECKPOINT:		checkpoint(session); break;
+        case OP_JOURNAL:		journal_mode(session, parameter1); break;
+        case OP_SNAPSHOT:		snapshot(session, parameter1, parameter2); break;
+        case OP_COUNT:			break;
+    }
+    return true;
+}
+
+void VFS::help(Session& session) {
+    ostream& out = *session.out;
     //print the available commands and their purposes
-    cout << "Available Commands:\n";
-    cout << "pwd                - Prints the path of the current directory.\n";
-    cout << "ls                 - Displays the contents of the current directory.\n";
-    cout << "mkdir <foldername> - Creates a new directory under the current one.\n";
-    cout << "touch <filename> <size> - Creates a new file with a specified size.\n";
-    cout << "cd <path>          - Changes the current directory to the specified path.\n";
-    cout << "find <name>        - Searches for files or directories with the specified name.\n";
-    cout << "mv <filename> <foldername> - Moves a file to the specified directory.\n";
-    cout << "rm <name>          - Removes a file or directory and places it in the bin.\n";
-    cout << "size <name>        - Displays the size of the specified file or directory.\n";
-    cout << "emptybin           - Empties the bin of deleted items.\n";
-    cout << "showbin            - Shows the oldest item in the bin.\n";
-    cout << "recover            - Restores the oldest item from the bin.\n";
-    cout << "exit               - Exits the program and saves the state.\n";
-}
-
-//Function to returnt the path of a file/folder as string
+    out << "Available Commands:\n";
+    out << "pwd                - Prints the path of the current directory.\n";
+    out << "ls                 - Displays the contents of the current directory.\n";
+    out << "ls sort [size|name|date] - Displays the contents sorted by size (largest first, the default), name or date.\n";
+    out << "ls --limit N [--after <name>] - Displays a page of N entries by name, the ones after name (printed at the end).\n";
+    out << "ls <pattern>       - Displays the entries matching a pattern such as *.conf, sorted by name.\n";
+    out << "mkdir <foldername> - Creates a new directory under the current one.\n";
+    out << "touch <filename> <size> - Creates a new file with a specified size.\n";
+    out << "cd <path>          - Changes the current directory to the specified path.\n";
+    out << "find <name> [scan] - Searches for files or directories with the specified name (scan walks the whole tree).\n";
+    out << "find --newer <date|path> - Lists what was created after a date (day-month-year) or after a file/folder.\n";
+    out << "find <pattern>     - Searches by pattern: * matches any characters and ? a single one (e.g. '*.txt', exp*).\n";
+    out << "mv <name> <foldername> - Moves a file or a folder with everything in it to the specified directory.\n";
+    out << "cp [-r] <name> <foldername> - Copies a file, or a folder with everything in it (-r), to the specified directory.\n";
+    out << "rm <name>          - Removes a file or directory and places it in the bin.\n";
+    out << "size <name>        - Displays the size of the specified file or directory.\n";
+    out << "size <name> verify - Recounts the size and checks it against the cached totals.\n";
+    out << "emptybin           - Empties the bin of deleted items.\n";
+    out << "binlimit [items] [bytes] - Shows or sets the limits of the bin (0 for no limit), the oldest items are purged beyond them.\n";
+    out << "showbin            - Shows the oldest item in the bin.\n";
+    out << "recover [path]     - Restores the item removed from path, or the oldest item, from the bin.\n";
+    out << "import <host-path> [folder] - Copies a directory of the host with its sizes and times into a folder (default the current one).\n";
+    out << "export [file]       - Saves the tree as a text file of path,size,date lines (default vfs.dat).\n";
+    out << "stats              - Shows the memory used by the Inodes and their names.\n";
+    out << "snapshot [name] [drop] - Lists the snapshots, takes a point-in-time view of the tree, or drops one.\n";
+    out << "cd @name[/path]    - Moves into a snapshot, which can be read like the tree (ls, find, size, export).\n";
+    out << "checkpoint         - Saves the tree and empties the journal of changes.\n";
+    out << "journal [off|async|sync] - Shows or sets how the changes are recorded for crash recovery.\n";
+    out << "threads [count]    - Shows or sets the threads of find <name> scan and size <name> verify (0 for one per core).\n";
+    out << "bench [path]       - Times a recount of a folder with 1 thread up to one per core.\n";
+    out << "bench ls           - Times the rows of ls for the current folder, with iostream and with its own formatter.\n";
+    out << "bench create [count] - Times the creation of files in a temporary folder (default 1000000).\n";
+    out << "bench journal [count] - Times touch with the journal off, async and sync (default 100000, a hundredth in sync).\n";
+    out << "bench simd         - Times the name kernels (validation, compare, search) at every level the CPU supports.\n";
+    out << "bench scan [pattern] - Times size / verify and find by pattern over the Inodes and over their flat copy.\n";
+    out << "bench vector [count] - Times Vector against std::vector: growth, iteration, strings and small lists (default 10000000).\n";
+    out << "bench fanout [max] - Times creating, looking up and removing names in folders of 1000, 10000... up to max entries (default 1000000).\n";
+    out << "bench cp [count]   - Times cp -r and mv of a folder on a temporary subtree of count Inodes (default 1000000).\n";
+    out << "bench deep [levels] - Times find and the paths of its hits in a temporary tree that deep (default 1000).\n";
+    out << "check [area]       - Runs the behaviour checks of the data structures, of one area or all of them.\n";
+    out << "                     Areas: index, vector, walker, journal, snapshot, paths, paging, flat, glob.\n";
+    out << "exit               - Exits the program and saves the state.\n";
+}
+
+//Function to return the path of the current directory of a session, in its snapshot if it is in one
+string VFS::pwd(const Session& session) {
+    return path_in(session.snapshot, session.cwd);
+}
+
+//Function to returnt the path of a file/folder as string. The length of the path is measured first and the
+//names are then written from the end, so every byte is copied once whatever the depth
 string VFS::pwd(Inode* node) const {
-    //if nothing is passed, make the default the current inode
-    if (node == nullptr) { node = curr_inode; }
-    //create a temp inode for iteration
-    Inode* temp = node;
-    //initialize the path 
-    string path = "";
-    //if the node is the root itself, save the name as /
-    if(temp == root) {path = "/";}
-    while (temp != root) {
-        //if not the root, store the name of its parent untill we reach the root
-        path = "/" + temp->name + path;
-        temp = temp->parent;
-    }
-    //return the path
+    //the root is the only path that ends with a slash
+    if (node == root) { return "/"; }
+    size_t length = 0;
+    for (Inode* temp = node; temp != root; temp = temp->parent) { length += temp->name.length() + 1; }
+    string path(length, '/');
+    for (Inode* temp = node; temp != root; temp = temp->parent) {
+        length -= temp->name.length();
+        memcpy(&path[length], temp->name.data(), temp->name.length());
+        length--;
+    }
     return path;
 }
 
 //Function to print the children of a current folder
 // Function definition: ls() in VFS (Virtual File System) class to print the children of the current folder
-void VFS::ls(string extention) {
+void VFS::ls(Session& session, string extention, string key) {
+    ostream& out = *session.out;
     // Check if the provided extension is empty, indicating a normal listing
+    Vector<Inode*>& children = children_in(session.snapshot, session.cwd);
     if(extention.empty()) {
-        // Iterate over the children of the current inode (directory or file)
-        for (Vector<Inode*>::Iterator it = curr_inode->children.begin(); it != curr_inode->children.end(); ++it) {
-            Inode* current = *it; // Get the current inode from the iterator
-            if (current->type == 0) {
-                // If it's a file (type 0), print its details: type, name, creation time, and size
-                cout << "File" << setw(15) << current->name << setw(15) << current->cr_time << setw(10) << current->size << "bytes" << endl;
-            }
-            else {
-                // If it's a folder, print its details: type, name, creation time, and size
-                cout << "dir" << setw(15) << current->name << setw(15) << current->cr_time << setw(10) << current->size << "bytes" << endl;
-            }
-        }
+        // Print the children of the current inode (directory or file): type, name, creation time, and size
+        print_rows(out, children.data(), children.size(), 15);
     } 
-    // Check if the extension is "sort", indicating a sorted listing
+    // Check if the arguments are paging options: the page holds the first entries by name after the cursor,
+    // so inserts and removals made between two pages never repeat or skip the other entries
+    else if (extention == "--limit" || extention == "--after") {
+        int limit = LS_PAGE;
+        string after;
+        stringstream options(extention + " " + key);
+        string option;
+        while (options >> option) {
+            if (option == "--limit" && options >> option) { limit = stoi(option); }
+            else if (option == "--after" && options >> option) { after = option; }
+            else { throw runtime_error("Invalid paging. Use 'ls --limit N [--after <name>]'."); }
+        }
+        if (limit < 1) { throw runtime_error("The limit of ls must be positive"); }
+        Vector<Inode*> page;
+        bool more;
+        {
+            //the folder is sorted once, every page is then a binary search for the cursor
+            lock_guard<mutex> guard(views_lock);
+            Vector<Inode*>& sorted = sorted_children(session, children);
+            Inode** begin = sorted.data();
+            Inode** end = begin + sorted.size();
+            Inode** from = upper_bound(begin, end, after, [](const string& a, Inode* b) { return strcmp(a.c_str(), b->name.c_str()) < 0; });
+            more = end - from > limit;
+            if (more) { end = from + limit; }
+            for (Inode** it = from; it != end; ++it) { page.push_back(*it); }
+        }
+        print_rows(out, page.data(), page.size(), 15);
+        if (more) { out << "-- more: ls --limit " << limit << " --after " << page[page.size() - 1]->name << endl; }
+    }
+    // Check if the extension is "sort", indicating a sorted listing: by size (largest first), name or date (oldest first)
     else if (extention == "sort") {
-        bool swapped;
-         do {
-            swapped = false;
-            // Iterate over the children for sorting
-            for (auto it = curr_inode->children.begin(); it != curr_inode->children.end(); ) {
-                auto next_it = it; // Create an iterator for the next element
-                ++next_it; // Increment to the next element
-                // If the next element exists and its size is larger, swap them
-                if (next_it != curr_inode->children.end() && (*it)->size < (*next_it)->size) {
-                    Inode* temp = *it; // Temporary storage for the swap
-                    *it = *next_it;
-                    *next_it = temp;
-                    swapped = true; // Indicate that a swap has occurred
-                }
-                if (next_it == curr_inode->children.end()) {
-                    break; // Prevent iterating past the end
-                }
-                ++it; // Move to the next element
+        if (key.empty()) { key = "size"; }
+        if (key != "size" && key != "name" && key != "date") { throw runtime_error("Invalid sort key. Use 'ls sort [size|name|date]'."); }
+        //sort an array of pointers, the folder keeps its order and other sessions may be reading it at the same time
+        Vector<Inode*> sorted(children.size());
+        if (key == "name") {
+            for (int i = 0; i < children.size(); ++i) { sorted.push_back(children[i]); }
+            sort(sorted.data(), sorted.data() + sorted.size(), [](Inode* a, Inode* b) { return strcmp(a->name.c_str(), b->name.c_str()) < 0; });
+        } else {
+            //the keys are computed once and sorted along with the pointers, equal keys keep the order of the folder
+            struct Keyed { long long key; Inode* node; };
+            Vector<Keyed> keyed(children.size());
+            for (int i = 0; i < children.size(); ++i) {
+                Keyed entry = { key == "size" ? (long long)children[i]->size : (long long)children[i]->created, children[i] };
+                keyed.push_back(entry);
             }
-        } while (swapped); // Repeat until no swaps are needed
-        
+            if (key == "size") {
+                stable_sort(keyed.data(), keyed.data() + keyed.size(), [](const Keyed& a, const Keyed& b) { return a.key > b.key; });
+            } else {
+                stable_sort(keyed.data(), keyed.data() + keyed.size(), [](const Keyed& a, const Keyed& b) { return a.key < b.key; });
+            }
+            for (int i = 0; i < keyed.size(); ++i) { sorted.push_back(keyed[i].node); }
+        }
+
         // After sorting, print the children similar to the first block
-        for (Vector<Inode*>::Iterator it = curr_inode->children.begin(); it != curr_inode->children.end(); ++it) {
-            Inode* current = *it;
-            if (current->type == 0) {
-                cout << "File" << setw(10) << current->name << setw(15) << current->cr_time << setw(10) << current->size << "bytes" << endl;
+        print_rows(out, sorted.data(), sorted.size(), 10);
+    }
+    // Check if the argument is a glob pattern, listing only the matching entries sorted by name
+    else if (is_glob(unquote(extention))) {
+        string pattern = unquote(extention);
+        GlobFilter filter(pattern);
+        Vector<Inode*> matched;
+        // Large folders are probed with the names matching the pattern anywhere in the tree, unless the pattern
+        // index has more names to test than the folder has children. Folders of snapshots are always scanned
+        // (the name index is the one of the tree)
+        Vector<Name> names_matched;
+        bool probe = false;
+        if (children.size() > LS_SCAN_MAX && session.snapshot == nullptr) {
+            lock_guard<mutex> guard(pool_lock);
+            probe = patterns.candidates(pattern) < children.size();
+            if (probe) { patterns.match(pattern, names_matched); }
+        }
+        if (!probe) {
+            for (Vector<Inode*>::Iterator it = children.begin(); it != children.end(); ++it) {
+                if (filter.match((*it)->name.data(), (*it)->name.length())) { matched.push_back(*it); }
             }
-            else {
-                cout << "dir" << setw(10) << current->name << setw(15) << current->cr_time << setw(10) << current->size << "bytes" << endl;
+        } else {
+            for (int i = 0; i < names_matched.size(); ++i) {
+                Inode* found = session.cwd->index.find(names_matched[i].data(), names_matched[i].length());
+                if (found != nullptr) { matched.push_back(found); }
             }
         }
-
+        sort(matched.data(), matched.data() + matched.size(), [](Inode* a, Inode* b) { return strcmp(a->name.c_str(), b->name.c_str()) < 0; });
+        print_rows(out, matched.data(), matched.size(), 15);
     } else {
         // If an invalid extension is provided, notify the user
-        throw runtime_error("Invalid extension. Either use 'ls' or 'ls sort'.");
+        throw runtime_error("Invalid extension. Either use 'ls', 'ls sort [size|name|date]', 'ls --limit N [--after <name>]' or 'ls <pattern>'.");
     }
 
 }
 
 //function to create new directory under the current directory
-void VFS::mkdir(string foldername) {
+void VFS::mkdir(Session& session, string foldername) {
     // Check if the folder name is valid by calling correct_name function
     if(!correct_name(foldername)) {
         // If the name is invalid, print an error message
         throw runtime_error("Wrong naming. Folder names can't be empty and should be alphanumeric only (i.e. comprises the letters A to Z, a to z, and the digits 0 to 9) without whitespaces or special characters, except the period “.” that can be used for file extensions.");
     } 
     // Check if the folder name already exists in the current directory by calling repeated_name function
-    else if(repeated_name(foldername)) {
+    else if(repeated_name(session.cwd, foldername)) {
         // If the name already exists, print an error message
         throw runtime_error("Foldername already exists. Please try again with a different name.");
     } 
     else {
         // If the name is valid and not repeated, create a new Inode for the folder
-        Inode* folder = new Inode(foldername, curr_inode, Folder, 10, currentTime());
+        Inode* folder = new_inode(foldername, session.cwd, Folder, 10, currentTime());
         // Add the new folder Inode to the children of the current Inode
-        curr_inode->children.push_back(folder);
-        // Initialize the children vector of the new folder Inode
-        folder->children = Vector<Inode*>();
+        link_child(session.cwd, folder);
+        if (journal.enabled()) {
+            JournalRecord change(J_MKDIR);
+            change.path = pwd(folder);
+            change.other_number = folder->created;
+            log_change(change);
+        }
     }
 }
 
 //Function to create new Files under the current directory
-void VFS::touch(string filename, unsigned int size) {
+void VFS::touch(Session& session, string filename, unsigned int size) {
     // Check if the file name is valid by calling correct_name function
     if(!correct_name(filename)) {
         // If the name is invalid, print an error message
         throw runtime_error("Wrong naming. File names can't be empty and should be alphanumeric only (i.e. comprises the letters A to Z, a to z, and the digits 0 to 9) without whitespaces or special characters, except the period “.” that can be used for file extensions.");
     } 
     // Check if the file name already exists in the current directory by calling repeated_name function
-    else if (repeated_name(filename)) {
+    else if (repeated_name(session.cwd, filename)) {
         // If the name already exists, print an error message
         throw runtime_error("File name already exists. Please try again with a different name.");
     } 
     else {
         // If the name is valid and not repeated, create a new Inode for the file
-        Inode* file = new Inode(filename, curr_inode, File, size, currentTime());
+        Inode* file = new_inode(filename, session.cwd, File, size, currentTime());
         // Add the new file Inode to the children of the current Inode
-        curr_inode->children.push_back(file);
-        // Initialize the children vector of the new file Inode (although files typically don't have children Inodes)
-        file->children = Vector<Inode*>();
-    }
-}
-
-Inode* VFS::getNode(string path) {
-    //check if it is the root 
-    if (path[0] == '/' && path.length() == 1) { return root; }
-    // If the path starts with '/', we start from the root, otherwise from the current directory.
-    Inode* node = (path[0] == '/') ? root : curr_inode;
-
-    // If the path starts with '/', skip the first character.
-    size_t pos = (path[0] == '/') ? 1 : 0;
-
-    // Current directory or file name being parsed.
-    string name;
-
-    // Parse the path by iterating over each character.
-    for (; pos <= path.length(); ++pos) {
-        // Check if we reached the end of a directory/file name or the end of the path.
-        if (pos == path.length() || path[pos] == '/') {
-            // Avoid processing empty names (which could happen with consecutive '/' characters).
-            if (!name.empty()) {
-                // Look for the directory/file in the current node's children.
-                bool found = false;
-                for (auto it = node->children.begin(); it != node->children.end(); ++it) {
-                    if ((*it)->name == name) {
-                        node = *it; // Move to the found node.
-                        found = true;
-                        break;
-                    }
-                }
-                // If the directory/file was not found, return nullptr.
-                if (!found) return nullptr;
-                
-                // Reset the name for the next directory/file.
-                name.clear();
-            }
-        } else {
-            // Accumulate characters to the current directory/file name.
-            name += path[pos];
+        link_child(session.cwd, file);
+        if (journal.enabled()) {
+            JournalRecord change(J_TOUCH);
+            change.path = pwd(file);
+            change.other_number = file->created;
+            change.number = size;
+            log_change(change);
         }
     }
-
-    // Return the node that corresponds to the last directory/file name found.
-    return node;
 }
 
-Inode* VFS::getParent(string path) {
-    // If the path starts with '/', we start from the root, otherwise from the current directory.
-    Inode* node = (path[0] == '/') ? root : curr_inode;
-    // Parent node initialized to the root or current directory as appropriate
-    Inode* parent = (path[0] == '/') ? root : curr_inode;
-
-    // If the path starts with '/', skip the first character.
-    size_t pos = (path[0] == '/') ? 1 : 0;
-
-    // Current directory or file name being parsed.
-    string name;
-
-    // Parse the path by iterating over each character.
-    for (; pos <= path.length(); ++pos) {
-        // Check if we reached the end of a directory/file name or the end of the path.
-        if (pos == path.length() || path[pos] == '/') {
-            // Avoid processing empty names (which could happen with consecutive '/' characters).
-            if (!name.empty()) {
-                // Look for the directory/file in the current node's children.
-                bool found = false;
-                for (auto it = node->children.begin(); it != node->children.end(); ++it) {
-                    if ((*it)->name == name) {
-                        parent = node; // Update parent to the current node
-                        node = *it;    // Move to the found node.
-                        found = true;
-                        break;
-                    }
-                }
-                // If the directory/file was not found, return nullptr.
-                if (!found) return nullptr;
-                
-                // Reset the name for the next directory/file.
-                name.clear();
-            }
-        } else {
-            // Accumulate characters to the current directory/file name.
-            name += path[pos];
+//Function to follow a path from base in one pass, giving the Inode it leads to and the parent of that Inode
+//(the Inode itself for the root or an empty path). Absolute paths are looked up in the path cache first
+bool VFS::resolve(Inode* base, const string& path, Inode*& node, Inode*& parent) {
+    bool absolute = !path.empty() && path[0] == '/';
+    if (absolute && path_cache.find(path, node, parent)) { return true; }
+    node = absolute ? root : base;
+    parent = node;
+    // Walk the names between the slashes, skipping the empty ones of consecutive '/' characters.
+    size_t start = 0;
+    while (start < path.length()) {
+        size_t end = path.find('/', start);
+        if (end == string::npos) { end = path.length(); }
+        if (end > start) {
+            parent = node;
+            node = lookup(node, path.data() + start, end - start);
+            if (node == nullptr) { return false; }
         }
+        start = end + 1;
     }
+    if (absolute) { path_cache.insert(path, node, parent); }
+    return true;
+}
 
-    // Return the parent of the node that corresponds to the last directory/file name found.
-    return parent;
+Inode* VFS::getNode(Inode* base, string path) {
+    Inode* node;
+    Inode* parent;
+    return resolve(base, path, node, parent) ? node : nullptr;
+}
+
+Inode* VFS::getParent(Inode* base, string path) {
+    Inode* node;
+    Inode* parent;
+    return resolve(base, path, node, parent) ? parent : nullptr;
 }
 
 
-void VFS::cd(string path) {
+void VFS::cd(Session& session, string path) {
+    ostream& out = *session.out;
+    //the current directory may be in a snapshot, names and .. are then resolved in the snapshot
+    Snapshot* view = session.snapshot;
     //check the extension after cd prompt
     //if "cd ..", then move the current inode to the parent inode
     if (path == "..") {
         //check if it is the root, return error
-        if (curr_inode == root) { cout << "This is the main folder." << endl; return; } 
+        if (session.cwd == root) { out << "This is the main folder." << endl; return; } 
         else {   
-        prev_inode = curr_inode;
-        curr_inode = curr_inode->parent;
+        session.prev = session.cwd;
+        session.prev_snapshot = view;
+        session.cwd = parent_in(view, session.cwd);
         }
     } else if (path == "-") { //if "cd -", move to the last working directory
         //check if there is no last working directory 
-        if(prev_inode == nullptr) { throw runtime_error("No last working directory"); } 
+        if(session.prev == nullptr) { throw runtime_error("No last working directory"); } 
         else {
-        Inode* temp = curr_inode;
-        curr_inode = prev_inode;
-        prev_inode = temp;
+        Inode* temp = session.cwd;
+        session.cwd = session.prev;
+        session.prev = temp;
+        session.snapshot = session.prev_snapshot;
+        session.prev_snapshot = view;
         }
     } else if (path.empty()) { //if "cd", move to the root
-        prev_inode = curr_inode;
-        curr_inode = root;
+        session.prev = session.cwd;
+        session.prev_snapshot = view;
+        session.cwd = root;
+        session.snapshot = nullptr;
+    } else if (path[0] == '@') { //if "cd @name/path", move to the path in a snapshot
+        size_t slash = path.find('/');
+        string name = path.substr(1, slash == string::npos ? string::npos : slash - 1);
+        Snapshot* target = find_snapshot(name);
+        if (target == nullptr) { throw runtime_error("No snapshot named " + name); }
+        Inode* node = node_in(target, root, slash == string::npos ? "" : path.substr(slash));
+        if (node == nullptr) { throw runtime_error("Path doesn't exist"); }
+        else if (node->type == File) { throw runtime_error("Cannot move to a file."); }
+        session.prev = session.cwd;
+        session.prev_snapshot = view;
+        session.cwd = node;
+        session.snapshot = target;
     } else if (path[0] == '/') { //if " cd /path" move to the specified path
         //call the function getNode to get a pointer to the iNode
-        Inode* Inode = getNode(path);
+        Inode* Inode = getNode(session.cwd, path);
         //check if it is found or not
         if (Inode == nullptr) {throw runtime_error("Path doesn't exist"); }
         //check if it is file or folder
         else if (Inode->type == 0) { throw runtime_error("Cannot move to a file."); } 
         //if folder, move the current node to the the Inode specified by the path
         else {
-            prev_inode = curr_inode;
-            curr_inode = Inode;
+            session.prev = session.cwd;
+            session.prev_snapshot = view;
+            session.cwd = Inode;
+            session.snapshot = nullptr;
         }
     } else { //if none of the above, then it is a name of a file or folder
-        //iterate through the children of the current folder to find the Inode 
-        bool found = false;
-        Inode* newInode = nullptr;
-        for (Vector<Inode*>::Iterator it = curr_inode->children.begin(); it != curr_inode->children.end(); ++it) {
-            if ((*it)->name == path) { 
-                newInode = *it;
-                found = true;
-                break; //The name cannot be repeated in the same folder
-            }
-        }
+        //look the name up in the index of the current folder to find the Inode
+        Inode* newInode = lookup_in(view, session.cwd, path);
         // if not child of the current node, throw an error and exit 
-        if (!found) {
+        if (newInode == nullptr) {
             throw runtime_error("The name provided is not a folder inside the current folder");
         }
         //if file, throw and error and exit 
@@ -358,72 +959,300 @@ void VFS::cd(string path) {
             throw runtime_error("The name provided is not a folder inside the current folder");
         }
         else {
-            prev_inode = curr_inode;
-            curr_inode = newInode;    
+            session.prev = session.cwd;
+            session.prev_snapshot = view;
+            session.cwd = newInode;    
         }   
     }
     //print the new path
-    string new_path = pwd();
-    cout << new_path << endl;
+    string new_path = pwd(session);
+    out << new_path << endl;
+}
+
+//Function to find the Inodes with a given name under a specific Inode by walking the whole subtree in parallel
+void VFS::find_helper(Inode* inode, const string& name, Vector<string>& paths, Snapshot* view) {
+    //every worker collects its own matches
+    Vector<Vector<Inode*> > found(walker.threads());
+    for (int i = 0; i < walker.threads(); ++i) { found.push_back(Vector<Inode*>()); }
+    bool glob = is_glob(name);
+    GlobFilter filter(name);
+    walk(inode, [&](Inode* node, int worker) -> Vector<Inode*>* {
+        if (glob ? filter.match(node->name.data(), node->name.length()) : node->name == name) {
+            found[worker].push_back(node);
+        }
+        return node->type == Folder ? &children_in(view, node) : nullptr;
+    });
+    for (int i = 0; i < found.size(); ++i) {
+        for (int j = 0; j < found[i].size(); ++j) { paths.push_back(path_in(view, found[i][j])); }
+    }
+}
+
+void VFS::find(Session& session, string name, string mode) {
+    ostream& out = *session.out;
+    if (name == "--newer") {
+        find_newer(session, mode);
+        return;
+    }
+    if (!mode.empty() && mode != "scan") {
+        throw runtime_error("Invalid option. Either use 'find <name>' or 'find <name> scan'.");
+    }
+    name = unquote(name);
+    Vector<string> paths;
+    if (session.snapshot != nullptr) {
+        //the name index is the one of the tree, a snapshot is always scanned
+        find_helper(root, name, paths, session.snapshot);
+    } else if (mode == "scan") {
+        //collect all the files/folders that has this name, scanning the flat copy of the tree
+        flat_find(name, paths);
+    } else if (!fully_expanded()) {
+        //the name index only holds materialized Inodes, the rest is read from the image as it is
+        find_unexpanded(name, paths);
+    } else if (is_glob(name)) {
+        //the pattern index gives the distinct names matching, each is then looked up like an exact name
+        Vector<Name> matched;
+        {
+            lock_guard<mutex> guard(pool_lock);
+            patterns.match(name, matched);
+        }
+        for (int i = 0; i < matched.size(); ++i) { find_paths(matched[i], paths); }
+    } else {
+        //a name that was never interned can't be the name of any Inode
+        Name interned;
+        bool known;
+        {
+            lock_guard<mutex> guard(pool_lock);
+            known = names.find(name, interned);
+        }
+        if (!known) { return; }
+        find_paths(interned, paths);
+    }
+    //print the paths in sorted order, so that the output doesn't depend on the creation order or the threads
+    sort(paths.data(), paths.data() + paths.size());
+    for (int i = 0; i < paths.size(); ++i) {
+        out << paths[i] << endl;
+    }
 }
 
-//recursive method to check if a given child is present under specific Inode or not
-void VFS::find_helper(Inode* inode, string name) {
-    if(inode->name == name) {
-        //if the name is found, print its path
-        cout << pwd(inode) << endl;
+//Function to print the paths of the files/folders created after a date (day-month-year, after its midnight)
+//or after the file/folder at a path, walking the whole tree (or snapshot)
+void VFS::find_newer(Session& session, const string& reference) {
+    ostream& out = *session.out;
+    if (reference.empty()) { throw runtime_error("Use 'find --newer <date|path>', with the date as day-month-year."); }
+    Snapshot* view = session.snapshot;
+    int64_t after;
+    if (!parse_date(reference.data(), reference.length(), after)) {
+        Inode* node = (view != nullptr) ? node_in(view, session.cwd, reference) : getNode(session.cwd, reference);
+        if (node == nullptr) { throw runtime_error(reference + " is neither a date nor an existing path"); }
+        after = node->created;
     }
-    for (Vector<Inode*>::Iterator it = inode->children.begin(); it != inode->children.end(); ++it){
-        //Do the same for each child
-        find_helper(*it, name);
+    Vector<Vector<Inode*> > found(walker.threads());
+    for (int i = 0; i < walker.threads(); ++i) { found.push_back(Vector<Inode*>()); }
+    walk(root, [&](Inode* node, int worker) -> Vector<Inode*>* {
+        if (node->created > after && node != root) { found[worker].push_back(node); }
+        return node->type == Folder ? &children_in(view, node) : nullptr;
+    });
+    Vector<string> paths;
+    for (int i = 0; i < found.size(); ++i) {
+        for (int j = 0; j < found[i].size(); ++j) { paths.push_back(path_in(view, found[i][j])); }
+    }
+    sort(paths.data(), paths.data() + paths.size());
+    for (int i = 0; i < paths.size(); ++i) {
+        out << paths[i] << endl;
+    }
+}
+
+//Function to copy the tree into the arrays of flat in pre-order, unless it didn't change since the last copy.
+//Readers share the copy: the tree can't change while they hold the tree lock, one of them copies it
+void VFS::flatten() {
+    lock_guard<mutex> guard(flat_lock);
+    if (flat.built && flat.version == tree_version) { return; }
+    flat.clear();
+    {
+        //every Inode of the tree is live, the arrays don't grow while they are filled
+        lock_guard<mutex> pool_guard(pool_lock);
+        flat.reserve(inodes.live());
+    }
+    struct Pending { Inode* inode; uint32_t parent; };
+    Vector<Pending> stack;
+    Pending first = { root, FLAT_NONE };
+    stack.push_back(first);
+    while (!stack.empty()) {
+        Pending next = stack.back();
+        stack.pop_back();
+        uint32_t index = flat.count();
+        Inode* inode = next.inode;
+        flat.add(inode, next.parent, inode->size, inode->total, inode->name);
+        if (inode->type == Folder) {
+            //pushed backwards, so that the children are copied in their order
+            Vector<Inode*>& children = children_of(inode);
+            for (int i = children.size() - 1; i >= 0; --i) {
+                Pending child = { children[i], index };
+                stack.push_back(child);
+            }
+        }
+    }
+    flat.version = tree_version;
+    flat.built = true;
+}
+
+//Function to recount the whole tree in its flat copy, with the Inodes whose cached total is wrong counted in mismatches
+unsigned long long VFS::flat_size(int* mismatches) {
+    flatten();
+    return flat.recount(mismatches);
+}
+
+//Function to add the paths of the Inodes of the tree with a name or matching a pattern, scanning its flat copy
+void VFS::flat_find(const string& name, Vector<string>& paths) {
+    flatten();
+    Vector<Inode*> hits;
+    if (is_glob(name)) {
+        flat.find_glob(name, hits);
+    } else {
+        //a name that was never interned can't be the name of any Inode
+        Name interned;
+        bool known;
+        {
+            lock_guard<mutex> guard(pool_lock);
+            known = names.find(name, interned);
+        }
+        if (known) { flat.find(interned, hits); }
+    }
+    for (int i = 0; i < hits.size(); ++i) { paths.push_back(pwd(hits[i])); }
+}
+
+//Function to add the paths of the Inodes with a name. The index also holds the Inodes in the bin,
+//only the ones reachable from the root are added
+void VFS::find_paths(Name name, Vector<string>& paths) {
+    lock_guard<mutex> guard(pool_lock);
+    Vector<Inode*>* same = by_name.find(name);
+    if (same == nullptr) { return; }
+    for (int i = 0; i < same->size(); ++i) {
+        if (is_inside((*same)[i], root)) { paths.push_back(pwd((*same)[i])); }
+    }
+}
+
+//Function to walk a subtree with the parallel walker. The walker is shared by the sessions and does one walk at
+//a time: a reader that finds it busy walks on its own thread rather than waiting, as worker 0
+void VFS::walk(Inode* inode, const WalkVisitor& visit) {
+    unique_lock<mutex> guard(walk_lock, try_to_lock);
+    if (guard.owns_lock()) {
+        walker.walk(inode, visit);
+        return;
+    }
+    Vector<Inode*> stack;
+    stack.push_back(inode);
+    while (!stack.empty()) {
+        Inode* node = stack.back();
+        stack.pop_back();
+        Vector<Inode*>* children = visit(node, 0);
+        if (children == nullptr) { continue; }
+        for (int i = children->size() - 1; i >= 0; --i) { stack.push_back((*children)[i]); }
+    }
+}
+
+//Function to materialize every folder below an Inode, in parallel
+void VFS::materialize(Inode* inode) {
+    walk(inode, [this](Inode* node, int) -> Vector<Inode*>* {
+        return node->type == Folder ? &children_of(node) : nullptr;
+    });
+}
+
+//Function to tell if every folder was materialized, so that the name index holds every name. New folders are
+//never lazy; the lazy folders of the bin count too, so the answer is only sure when it is true
+bool VFS::fully_expanded() {
+    lock_guard<mutex> guard(pool_lock);
+    return lazy_folders == 0;
+}
+
+//Function to find the Inodes with a name or matching a pattern while part of the tree is still only in the
+//image, without materializing it: the materialized folders are walked, and the records of the subtree of
+//each lazy folder are read from the image, the paths of the hits made from their parent records
+void VFS::find_unexpanded(const string& name, Vector<string>& paths) {
+    bool glob = is_glob(name);
+    GlobFilter filter(name);
+    auto matches = [&](const char* chars, size_t length) {
+        return glob ? filter.match(chars, length) : (length == name.length() && memcmp(chars, name.data(), length) == 0);
+    };
+    struct Lazy { Inode* folder; int record; };
+    Vector<Vector<Inode*> > found(walker.threads());
+    Vector<Vector<Lazy> > lazy(walker.threads());
+    for (int i = 0; i < walker.threads(); ++i) {
+        found.push_back(Vector<Inode*>());
+        lazy.push_back(Vector<Lazy>());
+    }
+    walk(root, [&](Inode* node, int worker) -> Vector<Inode*>* {
+        if (matches(node->name.data(), node->name.length())) { found[worker].push_back(node); }
+        if (node->type != Folder) { return nullptr; }
+        //another reader may materialize the folder meanwhile, the image it reads from stays the same
+        int record = node->image_record.load(memory_order_acquire);
+        if (record < 0) { return &node->children; }
+        Lazy folder = { node, record };
+        lazy[worker].push_back(folder);
+        return nullptr;
+    });
+    for (int i = 0; i < found.size(); ++i) {
+        for (int j = 0; j < found[i].size(); ++j) { paths.push_back(pwd(found[i][j])); }
+    }
+    Vector<uint32_t> stack;
+    Vector<uint32_t> chain;
+    for (int w = 0; w < lazy.size(); ++w) {
+        for (int l = 0; l < lazy[w].size(); ++l) {
+            uint32_t top = (uint32_t)lazy[w][l].record;
+            string prefix = (lazy[w][l].folder == root) ? "" : pwd(lazy[w][l].folder);
+            stack.push_back(top);
+            while (!stack.empty()) {
+                const ImageRecord& folder = image.record(stack.back());
+                stack.pop_back();
+                for (uint32_t c = folder.first_child; c < folder.first_child + folder.child_count; ++c) {
+                    const ImageRecord& r = image.record(c);
+                    if (r.type == Folder && r.child_count > 0) { stack.push_back(c); }
+                    if (!matches(image.name(r), r.name_length)) { continue; }
+                    //the names from the lazy folder down to the hit
+                    chain.clear();
+                    for (uint32_t up = c; up != top; up = image.record(up).parent) { chain.push_back(up); }
+                    string path = prefix;
+                    for (int k = chain.size() - 1; k >= 0; --k) {
+                        const ImageRecord& step = image.record(chain[k]);
+                        path += '/';
+                        path.append(image.name(step), step.name_length);
+                    }
+                    paths.push_back(path);
+                }
+            }
+        }
     }
 }
 
-void VFS::find(string name) {
-    //call the find helper function to print all the files/folders that has this name
-    find_helper(root, name);
+//Function to unmap the image once none of its folders is left to materialize. find reads the image without
+//pool_lock, so it is only closed while the tree lock is held for writing
+void VFS::release_image() {
+    lock_guard<mutex> guard(pool_lock);
+    if (lazy_folders == 0 && image.is_open()) { image.close(); }
 }
 
-void VFS::mv(string file, string folder) {
+void VFS::mv(Session& session, string file, string folder) {
     //initialize the variables needed
     bool file_found = false, folder_found = false;
-    Inode* file_inode;
-    Inode* folder_inode;
+    Inode* file_inode = nullptr;
+    Inode* folder_inode = nullptr;
     Inode* file_parent;
-    int index = 0, file_index = 0;  
 
     //check if it is absolute path for the file or not 
     if (file[0] == '/') {
-        file_inode = getNode(file);
-        //check if the file exists
-        if (file_inode == nullptr) { throw runtime_error("File path doesn't exist"); } 
+        //resolve the file and its parent in one pass
+        if (!resolve(session.cwd, file, file_inode, file_parent)) { throw runtime_error("File path doesn't exist"); }
         file_found = true;
-        //if exists, find the index of the file with respect to the vector of the parent such that the function 
-        //erase can be used
-        file_parent = file_inode->parent;
-        for (Vector<Inode*>::Iterator it = file_parent->children.begin(); it != file_parent->children.end(); ++it) {
-            if((*it)->name == file_inode->name && (*it)->type == File) {
-                file_index = index;
-            } 
-            index ++;
-        }        
     } else {
         // if not abolute path:
-        file_parent = curr_inode;
-        //Iterate through the children of the current inode to search for the file
-        for (Vector<Inode*>::Iterator it = curr_inode->children.begin(); it != curr_inode->children.end(); ++it) {
-            if((*it)->name == file && (*it)->type == File) {
-                file_inode = *it; //if the file exists, store ptr to its inode
-                file_found = true;
-                file_index = index;
-            } 
-            index ++;
-        }
+        file_parent = session.cwd;
+        //Look the file up in the index of the current inode
+        file_inode = lookup(session.cwd, file);
+        file_found = (file_inode != nullptr);
     }
 
     //check if it is absolute path for the folder or not 
     if (folder[0] == '/') {
-        folder_inode = getNode(folder);
+        folder_inode = getNode(session.cwd, folder);
         //check if the file exists
         if (folder_inode == nullptr) { throw runtime_error("Folder path doesn't exist"); } 
         else { 
@@ -431,118 +1260,226 @@ void VFS::mv(string file, string folder) {
         }
     } else {
     // if not abolute path:
-    //Iterate through the children of the parent inode to search for the folder
-        for (Vector<Inode*>::Iterator it = curr_inode->children.begin(); it != curr_inode->children.end(); ++it) {
-            if ((*it)->name == folder && (*it)->type == Folder) {
-                folder_inode = *it;  //if the folder exists, store ptr to its inode
-                folder_found = true;
-            } 
-    }
-
+    //Look the folder up in the index of the current inode
+        folder_inode = lookup(session.cwd, folder);
+        folder_found = (folder_inode != nullptr);
     }
     //Verify that the file/folder exists
-    if (!file_found || file_inode->type != File) { throw runtime_error("The file name entered doesn't exist"); }
+    if (!file_found) { throw runtime_error("The file or folder name entered doesn't exist"); }
     if (!folder_found || folder_inode->type != Folder) { throw runtime_error("The folder name entered doesn't exist"); }
-    if (!file_found || !folder_found || file_inode->type != File || folder_inode->type != Folder) { return; }
+    if (file_inode == root) { throw runtime_error("Cannot move the root folder"); }
+    //a folder moved below itself would be cut off from the tree
+    if (file_inode->type == Folder && is_inside(folder_inode, file_inode)) {
+        throw runtime_error("Cannot move a folder into itself or one of its subfolders");
+    }
+    Inode* existing = lookup(folder_inode, file_inode->name.data(), file_inode->name.length());
+    //already there, nothing to do
+    if (existing == file_inode) { return; }
+    if (existing != nullptr) { throw runtime_error("An item named " + file_inode->name + " already exists in the destination folder"); }
+    JournalRecord change(J_MV);
+    if (journal.enabled()) {
+        change.path = pwd(file_inode);
+        change.other = pwd(folder_inode);
+    }
 
-    //Add the file to the children of the new folder
-    folder_inode->children.push_back(file_inode);
-    //update the parent of the moved file/folder
-    file_inode->parent = folder_inode;
-    //remove the moved folder/file from its old dir
-    file_parent->children.erase(file_index);
+    //remove the moved file or folder from its old dir. A folder takes its whole subtree along: only its own
+    //link changes, and the totals of the old and the new ancestors
+    unlink_child(file_parent, file_inode);
+    //Add it to the children of the new folder, which also updates its parent
+    link_child(folder_inode, file_inode);
+    if (journal.enabled()) { log_change(change); }
+}
+
+//Function to copy a file, or a folder with -r, into a folder: cp <name> <folder> or cp -r <name> <folder>
+void VFS::cp(Session& session, string first, string rest) {
+    bool recursive = (first == "-r");
+    string source_path = first, folder_path = rest;
+    if (recursive) {
+        size_t space = rest.find(' ');
+        source_path = rest.substr(0, space);
+        folder_path = (space == string::npos) ? "" : rest.substr(space + 1);
+    }
+    if (source_path.empty() || folder_path.empty()) {
+        throw runtime_error("Please enter the command in the form of 'cp <filename> <foldername>' or 'cp -r <foldername> <foldername>'");
+    }
+    Inode* source = (source_path[0] == '/') ? getNode(session.cwd, source_path) : lookup(session.cwd, source_path);
+    Inode* folder = (folder_path[0] == '/') ? getNode(session.cwd, folder_path) : lookup(session.cwd, folder_path);
+    if (source == nullptr) { throw runtime_error("The file or folder name entered doesn't exist"); }
+    if (folder == nullptr || folder->type != Folder) { throw runtime_error("The folder name entered doesn't exist"); }
+    if (source->type == Folder && !recursive) { throw runtime_error("Use 'cp -r' to copy a folder"); }
+    int64_t created = currentTime();
+    copy_subtree(source, folder, created);
+    if (journal.enabled()) {
+        JournalRecord change(J_CP);
+        change.path = pwd(source);
+        change.other = pwd(folder);
+        change.other_number = created;
+        log_change(change);
+    }
+}
+
+//Function to copy a subtree into a folder, every copy created at the given time. The subtree is listed in
+//pre-order first; the copies are then made in one batch under one hold of pool_lock: their slots come from
+//blocks taken at once, the children arrays and indexes are sized once, the names are shared with the
+//originals and the totals copied from them. Only the root of the copy goes through link_child
+Inode* VFS::copy_subtree(Inode* source, Inode* folder, int64_t created) {
+    if (is_inside(folder, source)) { throw runtime_error("Cannot copy a folder into itself or one of its subfolders"); }
+    if (lookup(folder, source->name.data(), source->name.length()) != nullptr) {
+        throw runtime_error("An item named " + source->name + " already exists in the destination folder");
+    }
+    materialize(source);
+    Vector<Inode*> order;           //the subtree in pre-order
+    Vector<int> parent_at;          //position in order of the parent of each Inode, -1 for the root of the subtree
+    Vector<Inode*> stack;
+    Vector<int> stack_parent;
+    stack.push_back(source);
+    stack_parent.push_back(-1);
+    while (!stack.empty()) {
+        Inode* node = stack.back();
+        int parent = stack_parent.back();
+        stack.pop_back();
+        stack_parent.pop_back();
+        int at = order.size();
+        order.push_back(node);
+        parent_at.push_back(parent);
+        //pushed backwards, so the copies keep the order of the children
+        for (int i = node->children.size() - 1; i >= 0; --i) {
+            stack.push_back(node->children[i]);
+            stack_parent.push_back(at);
+        }
+    }
+    Vector<Inode*> copies(order.size());
+    {
+        lock_guard<mutex> guard(pool_lock);
+        inodes.reserve(order.size());
+        for (int i = 0; i < order.size(); ++i) {
+            Inode* original = order[i];
+            Inode* parent = (i == 0) ? folder : copies[parent_at[i]];
+            Inode* copy = make_inode(original->name, parent, original->type, original->size, created, false);
+            copy->total = original->total;
+            if (!original->children.empty()) {
+                copy->children.reserve(original->children.size());
+                copy->index.reserve(original->children.size());
+            }
+            if (i > 0) { insert_child(parent, copy); }
+            copies.push_back(copy);
+        }
+    }
+    //the totals of the copy are complete, its root adds them to the folder and its ancestors once
+    link_child(folder, copies[0]);
+    return copies[0];
 }
 
-void VFS::rm(string name) {
+void VFS::rm(Session& session, string name) {
     //verify that the folder/file is inside the current node. If not, print to the user and then close.
     //If found, store a ptr to it
-    int index = 0, index_file = 0;
     Inode* inode;
     Inode* parent;
     bool found = false;
     //check if it is absolute path or not
     if (name[0] != '/') {
         //if not a path, then it is under the current directory
-        parent = curr_inode;
-        for (Vector<Inode*>::Iterator it = parent->children.begin(); it != parent->children.end(); ++it) {
-            if ((*it)->name == name) { 
-                //if the name is found, save the node and exit
-                inode = *it;
-                index_file = index;
-                found = true;
-                break;
-            }
-            ++index;
-        }
+        parent = session.cwd;
+        inode = lookup(parent, name);
+        found = (inode != nullptr);
     } else {
-        //if it is a path, find the node referred by this path
-        inode = getNode(name);
-        //check if exists or not
-        if (inode == nullptr) { throw runtime_error("The path doesn't exist"); } 
-        else { 
-            found = true;
-        }
-        //if exists, find the index of the file with respect to the vector of the parent such that the function 
-        //erase can be used
-        parent = inode->parent;
-        for (Vector<Inode*>::Iterator it = parent->children.begin(); it != parent->children.end(); ++it) {
-            if((*it)->name == inode->name && (*it)->type == File) {
-                index_file = index;
-            } 
-            index ++;
-        }     
+        //if it is a path, find the node referred by this path and its parent in one pass
+        if (!resolve(session.cwd, name, inode, parent)) { throw runtime_error("The path doesn't exist"); }
+        found = true;
     }
 
     //check if it is found or not
     if (!found) { throw runtime_error("The folder/file name doesn't exist"); }
-    
-    if (bin.isFull()) {
-        throw runtime_error("Bin is full, cannot remove more items.");
-    } 
+    if (inode == root) { throw runtime_error("Cannot remove the root folder"); }
+    //the current directories of all the sessions must stay in the tree
+    //(the sessions in snapshots keep seeing their folders after they are removed)
+    for (int i = 0; i < sessions.size(); ++i) {
+        if (sessions[i]->snapshot == nullptr && is_inside(sessions[i]->cwd, inode)) {
+            throw runtime_error(sessions[i] == &session ? "Cannot remove a folder that contains the current directory"
+                                                         : "Cannot remove a folder that contains the current directory of another session");
+        }
+    }
+    //the previous directories can't be used anymore once they are in the bin
+    for (int i = 0; i < sessions.size(); ++i) {
+        if (sessions[i]->prev != nullptr && sessions[i]->prev_snapshot == nullptr && is_inside(sessions[i]->prev, inode)) { sessions[i]->prev = nullptr; }
+    }
 
     //Put the inode into the bin and save its path, old parent 
-    bin.enqueue(inode);
-    bin_paths.enqueue(pwd(inode));
-    bin_parents.enqueue(inode->parent);
-    //update its parent and erase it from its old directory
-    inode->parent = nullptr;
-    parent->children.erase(index_file);
+    JournalRecord change(J_RM);
+    change.path = pwd(inode);
+    bin.push(inode, change.path, parent, inode->total);
+    //erase it from its old directory, which also clears its parent
+    unlink_child(parent, inode);
+    //make room in the bin if it went over its limits
+    purge_bin();
+    if (journal.enabled()) { log_change(change); }
 }
 
 
-int VFS::getSize(Inode* inode) {
+//Recount the size of a subtree from scratch, ignoring the cached totals.
+//If mismatches is given, every Inode whose cached total differs from the recount is counted in it.
+unsigned long long VFS::getSize(Inode* inode, int* mismatches, Snapshot* view) {
     // Base case: if the inode is null, return 0
     if (inode == nullptr) {
         return 0;
     }
 
-    // If the inode is a folder, calculate the size of all children
-    int totalSize = inode->size; // Initialize with the folder's own size (10)
-    for (Vector<Inode*>::Iterator it = inode->children.begin(); it != inode->children.end(); ++it) {
-        totalSize += getSize(*it); // Recursively add the size of each child
+    // Every worker adds the own sizes of the Inodes it visits, padded so that they don't share a cache line
+    struct Partial { unsigned long long bytes; int mismatches; char padding[52]; };
+    Vector<Partial> partials(walker.threads());
+    for (int i = 0; i < walker.threads(); ++i) {
+        Partial empty = { 0, 0, {} };
+        partials.push_back(empty);
     }
+    walk(inode, [&](Inode* node, int worker) -> Vector<Inode*>* {
+        Partial& partial = partials[worker];
+        partial.bytes += node->size;
+        if (node->type == File) {
+            if (node->total != node->size) { partial.mismatches++; }
+            return nullptr;
+        }
+        // The cached total of a folder must be its own size plus the cached totals of its children
+        Vector<Inode*>& children = children_in(view, node);
+        unsigned long long expected = node->size;
+        for (int i = 0; i < children.size(); ++i) { expected += total_in(view, children[i]); }
+        if (expected != total_in(view, node)) { partial.mismatches++; }
+        return &children;
+    });
 
-    // Return the total size
+    // Add the partial results up in worker order
+    unsigned long long totalSize = 0;
+    for (int i = 0; i < partials.size(); ++i) {
+        totalSize += partials[i].bytes;
+        if (mismatches != nullptr) { *mismatches += partials[i].mismatches; }
+    }
     return totalSize;
 }
 
-void VFS::size(string name) {
+void VFS::size(Session& session, string name, string mode) {
+    ostream& out = *session.out;
+    if (!mode.empty() && mode != "verify") {
+        throw runtime_error("Invalid option. Either use 'size <name>' or 'size <name> verify'.");
+    }
     Inode* inode;
     bool found = false;
+    //names are looked up in the snapshot of the current directory, @name/path in the named snapshot
+    Snapshot* view = session.snapshot;
     //check if the input is absolute name or not
-    if (name[0] != '/') {
+    if (name[0] == '@') {
+        size_t slash = name.find('/');
+        view = find_snapshot(name.substr(1, slash == string::npos ? string::npos : slash - 1));
+        if (view == nullptr) { throw runtime_error("No snapshot named " + name.substr(1, slash == string::npos ? string::npos : slash - 1)); }
+        inode = node_in(view, root, slash == string::npos ? "" : name.substr(slash));
+        if (inode == nullptr) { throw runtime_error("The path doesn't exist"); }
+        found = true;
+    } else if (name[0] != '/') {
     //if not a path, then it is under the current directory
-        for (Vector<Inode*>::Iterator it = curr_inode->children.begin(); it != curr_inode->children.end(); ++it) {
-            if ((*it)->name == name) { 
-                //if the name is found, save the node and exit
-                inode = *it;
-                found = true;
-                break;
-            }
-        }
+        inode = lookup_in(view, session.cwd, name);
+        found = (inode != nullptr);
     } else {
+            view = nullptr;
             //if it is a path, find the node referred by this path
-            inode = getNode(name);
+            inode = getNode(session.cwd, name);
             //check if exists or not
             if (inode == nullptr) { throw runtime_error("The path doesn't exist"); } 
             else { 
@@ -552,50 +1489,1992 @@ void VFS::size(string name) {
 
     if (!found) { throw runtime_error("The folder/file name doesn't exist"); }
     //if it is a file, just print the size of it
-    if (inode->type == File) { cout << inode->size << endl; }
-    //if it is a folder, print the total size of it
+    if (inode->type == File) { out << inode->size << endl; }
+    //if it is a folder, print the cached total size of it
     else {
-        //Perform post-order iteration for the folder to calculate the size of all of its children
-        cout << getSize(inode) << " bytes" << endl;
+        out << total_in(view, inode) << " bytes" << endl;
+    }
+    //in verify mode, recount the whole subtree and compare it with the cached totals
+    if (mode == "verify") {
+        int mismatches = 0;
+        //the whole tree is recounted in its flat copy
+        unsigned long long recount = (inode == root && view == nullptr) ? flat_size(&mismatches) : getSize(inode, &mismatches, view);
+        if (mismatches != 0) {
+            throw runtime_error("Size cache is out of sync: recounted " + to_string(recount) + " bytes, " + to_string(mismatches) + " Inode(s) differ");
+        }
+        out << "Verified: " << recount << " bytes" << endl;
     }
-    
+
 }
 
 //function to show the first deleted element in the bin
-void VFS::showbin() {
+void VFS::showbin(Session& session) {
+    ostream& out = *session.out;
     //Notify the user if the bin is empty
-    if (bin_paths.isEmpty()) { cout << "The bin is empty" << endl;} else {
+    if (bin.empty()) { out << "The bin is empty" << endl;} else {
     //If not empty, print the details of the first removed file/folder
-    cout << "Next Element to remove: " << bin_paths.front_element() << "  (" << bin.front_element()->size << " bytes, " << bin.front_element()->cr_time << ")" << endl; 
+    BinRecord& item = bin.front();
+    out << "Next Element to remove: " << item.path << "  (" << item.inode->size << " bytes, " << format_date(item.inode->created) << ")" << endl; 
+    out << "Bin holds " << bin.size() << " item(s), " << bin.bytes() << " bytes" << endl;
     }
 }
 
 //function to delete all the elements inside the bin, without recovering any
-void VFS::emptybin() {
-    //while the bin is not empty, keep removing the front element
-    while(!bin.isEmpty()) {bin.dequeue();}
-    while(!bin_paths.isEmpty()) {bin_paths.dequeue();}
+void VFS::emptybin(Session& session) {
+    ostream& out = *session.out;
+    //while the bin is not empty, keep removing the front element and hand its subtree to the reclaimer
+    int items = bin.size();
+    unsigned long long bytes = bin.bytes();
+    while(!bin.empty()) {
+        reclaim(bin.remove(bin.front()));
+    }
+    if (journal.enabled()) { log_change(JournalRecord(J_EMPTYBIN)); }
+    out << "Emptied " << items << " item(s) (" << bytes << " bytes), freeing them in the background" << endl;
+}
+
+//function to purge the oldest items of the bin until it is within its limits again.
+//The newest item is always kept, even if it is larger than the byte limit on its own
+void VFS::purge_bin() {
+    while (bin.size() > 1 && ((bin_max_items > 0 && bin.size() > bin_max_items)
+                              || (bin_max_bytes > 0 && bin.bytes() > bin_max_bytes))) {
+        reclaim(bin.remove(bin.front()));
+    }
+}
+
+//function to show or change the limits of the bin
+void VFS::binlimit(Session& session, string items, string bytes) {
+    ostream& out = *session.out;
+    if (!items.empty()) {
+        bin_max_items = stoi(items);
+        if (!bytes.empty()) { bin_max_bytes = stoull(bytes); }
+        if (bin_max_items < 0) { bin_max_items = 0; }
+        purge_bin();
+        if (journal.enabled()) {
+            JournalRecord change(J_BINLIMIT);
+            change.number = bin_max_items;
+            change.other_number = bin_max_bytes;
+            log_change(change);
+        }
+    }
+    out << "Bin limits: " << (bin_max_items > 0 ? to_string(bin_max_items) : "unlimited") << " item(s), "
+         << (bin_max_bytes > 0 ? to_string(bin_max_bytes) : "unlimited") << " bytes" << endl;
 }
 
-void VFS::recover() {
-    //Find the inode need to be recovered
-    Inode* to_recover = bin.front_element();
+//function to restore an item from the bin: the newest item removed from the given path, or the oldest item
+void VFS::recover(Session& session, string path) {
+    if (bin.empty()) { throw runtime_error("The bin is empty"); }
+    BinRecord* item;
+    if (path.empty()) {
+        item = &bin.front();
+    } else {
+        //relative paths are relative to the current directory
+        if (path[0] != '/') { path = (session.cwd == root ? "" : pwd(session.cwd)) + "/" + path; }
+        while (path.length() > 1 && path[path.length() - 1] == '/') { path.erase(path.length() - 1); }
+        item = bin.find(path);
+        if (item == nullptr) { throw runtime_error("Nothing was removed from " + path); }
+    }
+    Inode* to_recover = item->inode;
     //check if the old parent still exists
-    Inode* parent = getNode(pwd(bin_parents.front_element()));
-    if (parent == nullptr) { throw runtime_error("The parent of the file/folder no longer exists"); }
-    //push the element back to its parent 
-    parent->children.push_back(to_recover);
-    //update the parent of the node
-    to_recover->parent = parent;
-    //remove the element from the bins
-    bin.dequeue();
-    bin_paths.dequeue();
-    bin_parents.dequeue();
-}
-
-void VFS::exit() {
-    // Print a goodbye message 
-    cout << "Exiting the Virtual File System. Goodbye!" << endl;
-    // Exit the program
-    std::exit(0); 
+    Inode* parent = item->parent;
+    if (!is_inside(parent, root)) { throw runtime_error("The parent of the file/folder no longer exists"); }
+    if (lookup(parent, to_recover->name.str()) != nullptr) {
+        throw runtime_error("A file/folder named " + to_recover->name.str() + " already exists in " + pwd(parent));
+    }
+    //push the element back to its parent, which also updates the parent of the node
+    link_child(parent, to_recover);
+    //remove the element from the bin
+    bin.remove(*item);
+    if (journal.enabled()) {
+        JournalRecord change(J_RECOVER);
+        change.path = path;
+        log_change(change);
+    }
+}
+
+void VFS::exit(Session& session) {
+    ostream& out = *session.out;
+    // Save the tree so that the next session starts from it, the journal is not needed anymore
+    save_checkpoint();
+    // Print a goodbye message, the caller of execute ends the program
+    out << "Exiting the Virtual File System. Goodbye!" << endl;
+}
+
+//Function to load the tree from a file of "path,size,date" lines (the format of vfs.dat).
+//Parents always come before their children, so the Inodes of the previous path are kept on a stack
+//and only the segments that differ from it are looked up. Folder lines carry the total size of the folder.
+void VFS::load(const string& filename) {
+    FILE* in = fopen(filename.c_str(), "rb");
+    //nothing saved yet, start with an empty tree
+    if (in == nullptr) { return; }
+
+    Vector<Inode*> stack;               //stack[d] is the Inode at depth d of the previous path
+    Vector<unsigned long long> stored;  //size read from the file for each Inode on the stack
+    stack.push_back(root);
+    stored.push_back(0);
+    int depth = 1;                      //number of valid entries on the stack
+    int skipped = 0;                    //number of malformed lines
+
+    size_t capacity = IO_CHUNK;
+    char* buffer = new char[capacity];
+    size_t filled = 0;
+    bool eof = false;
+    while (!eof || filled > 0) {
+        //read the next chunk after the unprocessed tail of the previous one
+        if (!eof) {
+            size_t n = fread(buffer + filled, 1, capacity - filled, in);
+            if (n == 0) { eof = true; }
+            filled += n;
+        }
+        size_t start = 0;
+        while (start < filled) {
+            char* line = buffer + start;
+            char* newline = static_cast<char*>(memchr(line, '\n', filled - start));
+            //keep a partial line for the next chunk, unless the file ended without a newline
+            if (newline == nullptr && !eof) { break; }
+            size_t length = (newline != nullptr) ? newline - line : filled - start;
+            start += length + 1;
+            if (length > 0 && line[length - 1] == '\r') { length--; }
+            if (length == 0) { continue; }
+            if (!load_line(line, length, stack, stored, depth)) { skipped++; }
+        }
+        if (start >= filled) {
+            filled = 0;
+        } else {
+            //move the partial line to the front, growing the buffer if a single line fills it
+            filled -= start;
+            memmove(buffer, buffer + start, filled);
+            if (filled == capacity) {
+                char* bigger = new char[capacity * 2];
+                memcpy(bigger, buffer, filled);
+                delete[] buffer;
+                buffer = bigger;
+                capacity *= 2;
+            }
+        }
+    }
+    delete[] buffer;
+    fclose(in);
+
+    //the Inodes still on the stack never got a following line
+    while (depth > 1) {
+        depth--;
+        finish_loaded(stack[depth], stored[depth]);
+    }
+    if (skipped > 0) {
+        cout << "Warning: skipped " << skipped << " malformed line(s) in " << filename << endl;
+    }
+}
+
+//Function to add the Inode described by one "path,size,date" line, returns false if the line is malformed
+bool VFS::load_line(const char* line, size_t length, Vector<Inode*>& stack, Vector<unsigned long long>& stored, int& depth) {
+    //split the line into path, size and date
+    const char* comma1 = static_cast<const char*>(memchr(line, ',', length));
+    if (comma1 == nullptr || line[0] != '/') { return false; }
+    const char* comma2 = static_cast<const char*>(memchr(comma1 + 1, ',', line + length - comma1 - 1));
+    if (comma2 == nullptr || comma2 == comma1 + 1) { return false; }
+    unsigned long long size = 0;
+    for (const char* c = comma1 + 1; c < comma2; ++c) {
+        if (*c < '0' || *c > '9') { return false; }
+        size = size * 10 + (*c - '0');
+    }
+    //a date that can't be read leaves the Inode at the epoch rather than dropping its subtree
+    int64_t date = 0;
+    parse_date(comma2 + 1, line + length - comma2 - 1, date);
+
+    //the root line only carries the creation date of the root
+    const char* path_end = comma1;
+    while (path_end > line + 1 && path_end[-1] == '/') { path_end--; }
+    if (path_end == line + 1) {
+        root->created = date;
+        return true;
+    }
+
+    //walk the path segments, reusing the Inodes of the previous line as long as they match
+    const char* seg = line + 1;
+    int level = 1;
+    while (true) {
+        const char* seg_end = static_cast<const char*>(memchr(seg, '/', path_end - seg));
+        if (seg_end == nullptr) { break; }
+        if (seg_end == seg) { return false; }
+        string name(seg, seg_end);
+        if (level >= depth || stack[level]->name != name) {
+            //the previous path diverges here: finish the Inodes that are popped and look this one up
+            while (depth > level) {
+                depth--;
+                finish_loaded(stack[depth], stored[depth]);
+            }
+            Inode* next = lookup(stack[level - 1], name);
+            if (next == nullptr) { return false; }
+            if (level == stack.size()) { stack.push_back(next); stored.push_back(10); }
+            else { stack[level] = next; stored[level] = 10; }
+            depth = level + 1;
+        }
+        seg = seg_end + 1;
+        level++;
+    }
+
+    //the last segment is the new Inode, a child of the Inode at the previous level
+    string name(seg, path_end);
+    if (!correct_name(name)) { return false; }
+    while (depth > level) {
+        depth--;
+        finish_loaded(stack[depth], stored[depth]);
+    }
+    Inode* parent = stack[level - 1];
+    if (parent->type == File) { convert_to_folder(parent); }
+    Inode* inode = lookup(parent, name);
+    if (inode == nullptr) {
+        //names with an extension are files, the others start as folders and become files in finish_loaded
+        //if they turn out to have no children and a size that an empty folder cannot have
+        if (name.find('.') != string::npos) {
+            inode = new_inode(name, parent, File, (unsigned int)size, date);
+        } else {
+            inode = new_inode(name, parent, Folder, 10, date);
+        }
+        link_child(parent, inode);
+    }
+    if (level == stack.size()) { stack.push_back(inode); stored.push_back(size); }
+    else { stack[level] = inode; stored[level] = size; }
+    depth = level + 1;
+    return true;
+}
+
+//Function called when a loaded Inode gets its last child: an empty "folder" whose saved size is not
+//the size of an empty folder was an extensionless file
+void VFS::finish_loaded(Inode* inode, unsigned long long stored_size) {
+    if (inode->type == Folder && inode->children.empty() && stored_size != 10) {
+        inode->type = File;
+        add_total(inode, (long long)stored_size - (long long)inode->size);
+        inode->size = (unsigned int)stored_size;
+    }
+}
+
+//Function to turn a loaded file into a folder (a later line has it as parent)
+void VFS::convert_to_folder(Inode* inode) {
+    inode->type = Folder;
+    add_total(inode, 10 - (long long)inode->size);
+    inode->size = 10;
+}
+
+//Function to read a directory tree of the host for import, in parallel. It only holds the tree lock to read
+//the number of threads, the caller frees the scan
+HostScan* VFS::scan_host(const string& host_path) {
+    if (host_path.empty()) { throw runtime_error("Please enter the command in the form of 'import <host-path> [folder]'"); }
+    int threads;
+    {
+        ReadGuard guard(tree_lock);
+        threads = walker.threads();
+    }
+    unique_ptr<HostScan> scan(new HostScan());
+    scan->scan(host_path, threads);
+    return scan.release();
+}
+
+//Function to copy a directory tree of the host, read by scan_host before the tree lock was taken, into a
+//folder with the real sizes and modification times. The entries are created under one hold of pool_lock per
+//folder and linked without add_total: the totals are summed bottom-up at the end and added once to each
+//folder that existed before. Existing folders are merged into; existing files and names the VFS doesn't
+//allow are skipped. Every created entry is journaled like mkdir and touch would, parents first
+void VFS::import(Session& session, string folder_path) {
+    ostream& out = *session.out;
+    HostScan& scan = *session.host_scan;
+    Inode* target = folder_path.empty() ? session.cwd : getNode(session.cwd, folder_path);
+    if (target == nullptr || target->type != Folder) { throw runtime_error("The folder " + folder_path + " doesn't exist"); }
+
+    typedef chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+
+    //folders still to fill: a listing of the host and the Inode it goes into, with its position in merged
+    //if the Inode existed before the import (-1 for the folders made by it)
+    struct Pending { int listing; Inode* folder; int merged; };
+    Vector<Pending> stack;
+    Vector<Inode*> merged;              //folders that existed and got new entries
+    Vector<unsigned long long> added;   //bytes added right below each of them
+    Vector<Inode*> made;                //created Inodes, every parent before its children
+    Vector<int> owner;                  //for each of them, the position of its parent in merged or -1
+    unsigned long long skipped = scan.others(), folders = 0, files = 0;
+    merged.push_back(target);
+    added.push_back(0);
+    Pending first = { 0, target, 0 };
+    stack.push_back(first);
+    while (!stack.empty()) {
+        Pending next = stack.back();
+        stack.pop_back();
+        const HostListing& listing = scan.listing(next.listing);
+        Inode* folder = next.folder;
+        if (next.merged >= 0) {
+            expand(folder);
+            freeze_children(folder);
+        }
+        folder->children.reserve(folder->children.size() + listing.entries.size());
+        lock_guard<mutex> guard(pool_lock);
+        for (int i = 0; i < listing.entries.size(); ++i) {
+            const HostEntry& entry = listing.entries[i];
+            const char* name = listing.names.data() + entry.name;
+            if (!correct_name(name, entry.length)) { skipped++; continue; }
+            if (next.merged >= 0) {
+                Inode* existing = folder->index.find(name, entry.length);
+                if (existing != nullptr) {
+                    if (existing->type == Folder && entry.folder) {
+                        merged.push_back(existing);
+                        added.push_back(0);
+                        Pending inside = { entry.listing, existing, merged.size() - 1 };
+                        stack.push_back(inside);
+                    } else {
+                        skipped++;
+                    }
+                    continue;
+                }
+            }
+            //sizes past what an Inode holds are cut to its largest size
+            unsigned int size = entry.folder ? 10 : (unsigned int)min(entry.size, 0xFFFFFFFFull);
+            Inode* inode = make_inode(intern(name, entry.length), folder, entry.folder ? Folder : File, size, entry.modified, false);
+            insert_child(folder, inode);
+            made.push_back(inode);
+            owner.push_back(next.merged);
+            if (entry.folder) {
+                folders++;
+                Pending inside = { entry.listing, inode, -1 };
+                stack.push_back(inside);
+            } else {
+                files++;
+            }
+        }
+    }
+    //children come after their parents in made, so going backwards every total is complete before it is added up
+    for (int i = made.size() - 1; i >= 0; --i) {
+        if (owner[i] < 0) { made[i]->parent->total += made[i]->total; }
+        else { added[owner[i]] += made[i]->total; }
+    }
+    unsigned long long bytes = 0;
+    for (int i = 0; i < merged.size(); ++i) {
+        if (added[i] > 0) { add_total(merged[i], (long long)added[i]); }
+        bytes += added[i];
+    }
+    //the Inodes were linked without add_total, and empty files add no bytes: the flat copy is out of date all the same
+    if (!made.empty()) { tree_version++; }
+    if (journal.enabled()) {
+        for (int i = 0; i < made.size(); ++i) {
+            JournalRecord change(made[i]->type == Folder ? J_MKDIR : J_TOUCH);
+            change.path = pwd(made[i]);
+            if (made[i]->type == File) { change.number = made[i]->size; }
+            change.other_number = made[i]->created;
+            log_change(change);
+        }
+    }
+    Clock::time_point linked = Clock::now();
+
+    double linking = chrono::duration<double>(linked - start).count();
+    double seconds = scan.seconds() + linking;
+    out << "Imported " << made.size() << " entries (" << folders << " folders, " << files << " files, " << bytes
+        << " bytes) in " << fixed << setprecision(1) << seconds * 1000 << " ms: scan "
+        << scan.seconds() * 1000 << " ms, link " << linking * 1000 << " ms, " << setprecision(0)
+        << (seconds > 0 ? made.size() / seconds : 0) << " entries/s" << endl;
+    out.unsetf(ios::floatfield);
+    int unreadable = scan.unreadable();
+    if (skipped > 0 || unreadable > 0) {
+        out << "Skipped " << skipped << " entries (names the VFS doesn't allow, existing files, links and devices), "
+            << unreadable << " unreadable folder(s)" << endl;
+    }
+}
+
+//Function to save the tree to a file of "path,size,date" lines, parents before children
+void VFS::save(const string& filename, Snapshot* view) {
+    //write to a temporary file first so that a failed save never destroys the previous one. export only reads
+    //the tree, so sessions may save to the same file at once: each writes a temporary file of its own
+    string temp_name = filename + ".XXXXXX";
+    int fd = mkstemp(&temp_name[0]);
+    if (fd < 0) { throw runtime_error("Cannot create a temporary file next to " + filename); }
+    fchmod(fd, 0644);
+    FILE* out = fdopen(fd, "wb");
+    if (out == nullptr) {
+        close(fd);
+        remove(temp_name.c_str());
+        throw runtime_error("Cannot open " + temp_name + " for writing");
+    }
+    string buffer;
+    buffer.reserve(IO_CHUNK + 4096);
+    string path;
+    bool ok = save_helper(root, path, buffer, out, view);
+    ok = ok && fwrite(buffer.data(), 1, buffer.size(), out) == buffer.size();
+    ok = (fclose(out) == 0) && ok;
+    if (!ok || rename(temp_name.c_str(), filename.c_str()) != 0) {
+        remove(temp_name.c_str());
+        throw runtime_error("Cannot save the VFS to " + filename);
+    }
+}
+
+//recursive pre-order helper of save, path holds the path of the parent of inode. Returns false if a write failed
+bool VFS::save_helper(Inode* inode, string& path, string& buffer, FILE* out, Snapshot* view) {
+    size_t parent_length = path.length();
+    if (inode != root) {
+        path += '/';
+        path.append(inode->name.data(), inode->name.length());
+    }
+    buffer += (inode == root) ? "/" : path;
+    buffer += ',';
+    //folders are saved with their total size, like in vfs.dat
+    buffer += to_string(inode->type == Folder ? total_in(view, inode) : (unsigned long long)inode->size);
+    buffer += ',';
+    buffer += format_date(inode->created);
+    buffer += '\n';
+    //flush the buffer in large chunks
+    if (buffer.size() >= IO_CHUNK) {
+        if (fwrite(buffer.data(), 1, buffer.size(), out) != buffer.size()) { return false; }
+        buffer.clear();
+    }
+    Vector<Inode*>& children = children_in(view, inode);
+    for (Vector<Inode*>::Iterator it = children.begin(); it != children.end(); ++it) {
+        if (!save_helper(*it, path, buffer, out, view)) { return false; }
+    }
+    path.resize(parent_length);
+    return true;
+}
+
+//Function to save the tree as text, so that it can be imported again or read by other tools
+void VFS::export_dat(Session& session, string filename) {
+    ostream& out = *session.out;
+    if (filename.empty()) { filename = VFS_FILE; }
+    //in a snapshot, the whole snapshot is exported
+    save(filename, session.snapshot);
+    out << "Exported " << (session.snapshot != nullptr ? "@" + session.snapshot->name : string("the VFS")) << " to " << filename << endl;
+}
+
+//Function to open a binary image saved by save_image. Only the root is materialized, the other
+//folders are materialized from the mapped records the first time their children are needed
+bool VFS::open_image(const string& filename) {
+    if (!image.open(filename)) { return false; }
+    const ImageRecord& record = image.record(0);
+    root->size = record.size;
+    root->total = record.total;
+    root->created = image_created(record);
+    lazy_folders = 0;
+    if (record.child_count > 0) {
+        root->image_record = 0;
+        lazy_folders = 1;
+    }
+    checkpoint_id = image.checkpoint();
+    uint64_t max_items, max_bytes;
+    if (image.bin_limits(max_items, max_bytes)) {
+        bin_max_items = (int)max_items;
+        bin_max_bytes = max_bytes;
+    }
+
+    //the items of the bin come back in their order, as lazy subtrees like the tree itself
+    HashMap<long long, Inode*> bin_roots;
+    Vector<Inode*> items;
+    for (uint32_t i = 0; i < image.bin_count(); ++i) {
+        const ImageRecord& r = image.record(image.bin_item(i).record);
+        if (r.parent != IMAGE_NONE) { throw runtime_error("Corrupt VFS image: wrong bin item"); }
+        lock_guard<mutex> guard(pool_lock);
+        Inode* inode = make_inode(intern(image.name(r), r.name_length), nullptr, r.type == Folder ? Folder : File,
+                                  r.size, image_created(r), true);
+        inode->total = r.total;
+        if (r.type == Folder && r.child_count > 0) {
+            inode->image_record = image.bin_item(i).record;
+            lazy_folders++;
+        }
+        bin_roots[image.bin_item(i).record] = inode;
+        items.push_back(inode);
+    }
+    //the parents may be anywhere in the tree or in the other items, they are found once all the items exist
+    for (uint32_t i = 0; i < image.bin_count(); ++i) {
+        const ImageBinItem& item = image.bin_item(i);
+        Inode* parent = (item.parent == IMAGE_NONE) ? nullptr : image_inode(item.parent, bin_roots);
+        bin.push(items[i], string(image.path(item), item.path_length), parent, items[i]->total);
+    }
+    if (lazy_folders == 0) { image.close(); }
+    return true;
+}
+
+//Function to read the creation time of a record, stored as a date in the text before version 3 of the image
+int64_t VFS::image_created(const ImageRecord& record) {
+    int64_t created = 0;
+    if (image.version() >= 3) {
+        if (record.date_length == sizeof(created)) { memcpy(&created, image.date(record), sizeof(created)); }
+    } else {
+        parse_date(image.date(record), record.date_length, created);
+    }
+    return created;
+}
+
+//Function to get the Inode of a record of the image, materializing the folders on its path
+Inode* VFS::image_inode(uint32_t index, HashMap<long long, Inode*>& bin_roots) {
+    if (index == 0) { return root; }
+    const ImageRecord& r = image.record(index);
+    if (r.parent == IMAGE_NONE) {
+        Inode** item = bin_roots.find(index);
+        if (item == nullptr) { throw runtime_error("Corrupt VFS image: wrong parent"); }
+        return *item;
+    }
+    //the children of a folder are materialized in the order of their records
+    Inode* parent = image_inode(r.parent, bin_roots);
+    uint32_t first = image.record(r.parent).first_child;
+    Vector<Inode*>& children = children_of(parent);
+    if (index < first || index - first >= (uint32_t)children.size()) { throw runtime_error("Corrupt VFS image: wrong parent"); }
+    return children[index - first];
+}
+
+//Function to materialize the children of a folder opened from an image
+//Readers may expand folders concurrently: the record is checked again under pool_lock and only cleared
+//once the children are in place, so a reader that sees -1 also sees all the children
+void VFS::expand(Inode* folder) {
+    if (folder->image_record.load(memory_order_acquire) < 0) { return; }
+    lock_guard<mutex> guard(pool_lock);
+    if (folder->image_record.load(memory_order_relaxed) < 0) { return; }
+    uint32_t index = folder->image_record;
+    const ImageRecord& record = image.record(index);
+    folder->children.reserve(record.child_count);
+    uint32_t child = record.first_child;
+    for (uint32_t i = 0; i < record.child_count; ++i, ++child) {
+        const ImageRecord& r = image.record(child);
+        if (r.parent != index) { throw runtime_error("Corrupt VFS image: wrong parent"); }
+        Inode* inode = make_inode(intern(image.name(r), r.name_length), folder, r.type == Folder ? Folder : File,
+                                  r.size, image_created(r), true);
+        //the totals of the image already include this subtree, so the child is attached without add_total
+        inode->total = r.total;
+        if (r.type == Folder && r.child_count > 0) {
+            inode->image_record = child;
+            lazy_folders++;
+        }
+        insert_child(folder, inode);
+    }
+    folder->image_record.store(-1, memory_order_release);
+    //once every folder is materialized the image is not needed anymore, the next command that changes the
+    //tree unmaps it (release_image)
+    lazy_folders--;
+}
+
+//Function to get the children of a folder, materializing them first if needed
+Vector<Inode*>& VFS::children_of(Inode* folder) {
+    expand(folder);
+    return folder->children;
+}
+
+//Function to save the tree as a binary image: header, records in breadth-first order, string table.
+//Folders that were never materialized are copied straight from the mapped image.
+void VFS::save_image(const string& filename, uint64_t checkpoint) {
+    //write to a temporary file first, the current image may still be mapped
+    string temp_name = filename + ".tmp";
+    FILE* out = fopen(temp_name.c_str(), "wb");
+    if (out == nullptr) { throw runtime_error("Cannot open " + temp_name + " for writing"); }
+
+    //an entry of the breadth-first queue is either an Inode or a record of the mapped image
+    struct Entry {
+        Inode* inode;
+        uint32_t record;
+        uint32_t parent;
+        bool last;          //last child of its parent
+    };
+    deque<Entry> queue;
+    Entry first = { root, 0, IMAGE_NONE, true };
+    queue.push_back(first);
+    //the items of the bin are roots of their own, right after the root. Their old parents get the index
+    //of their record when the walk reaches them
+    HashMap<Inode*, uint32_t> parents;
+    for (int i = 0; i < bin.length(); ++i) {
+        BinRecord& item = bin.at(i);
+        if (!item.live) { continue; }
+        Entry entry = { item.inode, 0, IMAGE_NONE, true };
+        queue.push_back(entry);
+        if (item.parent != nullptr) { parents[item.parent] = IMAGE_NONE; }
+    }
+
+    ImageHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    header.version = IMAGE_VERSION;
+    header.record_size = sizeof(ImageRecord);
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+
+    string records;         //records waiting to be written
+    string strings;         //string table, written after the records
+    int64_t last_date = 0;  //creation times of siblings loaded from text are usually equal, so consecutive duplicates are shared
+    bool have_date = false;
+    uint32_t last_date_offset = 0;
+    uint64_t count = 0;     //number of records written so far
+    uint64_t next = queue.size();   //index the next enqueued child gets
+    while (!queue.empty() && ok) {
+        Entry entry = queue.front();
+        queue.pop_front();
+        if (entry.inode != nullptr) {
+            uint32_t* parent = parents.find(entry.inode);
+            if (parent != nullptr) { *parent = count; }
+        }
+        ImageRecord record;
+        memset(&record, 0, sizeof(record));
+        const char* name;
+        int64_t date;
+        if (entry.inode != nullptr && entry.inode->image_record < 0) {
+            //materialized Inode: its children are in the children vector
+            Inode* inode = entry.inode;
+            record.total = inode->total;
+            record.size = inode->size;
+            record.type = inode->type;
+            record.name_length = inode->name.length();
+            name = inode->name.data();
+            date = inode->created;
+            record.child_count = inode->children.size();
+            for (int i = 0; i < inode->children.size(); ++i) {
+                Entry child = { inode->children[i], 0, (uint32_t)count, i == inode->children.size() - 1 };
+                queue.push_back(child);
+            }
+        } else {
+            //record of the mapped image: its children are consecutive records
+            uint32_t source = (entry.inode != nullptr) ? (uint32_t)entry.inode->image_record.load() : entry.record;
+            const ImageRecord& r = image.record(source);
+            record.total = r.total;
+            record.size = r.size;
+            record.type = r.type;
+            record.name_length = r.name_length;
+            name = image.name(r);
+            date = image_created(r);
+            if (entry.inode != nullptr) {
+                //a lazy folder keeps its own name and date in the Inode
+                record.name_length = entry.inode->name.length();
+                name = entry.inode->name.data();
+                date = entry.inode->created;
+            }
+            record.child_count = r.child_count;
+            for (uint32_t i = 0; i < r.child_count; ++i) {
+                Entry child = { nullptr, r.first_child + i, (uint32_t)count, i == r.child_count - 1 };
+                queue.push_back(child);
+            }
+        }
+        record.parent = entry.parent;
+        record.first_child = (record.child_count > 0) ? (uint32_t)next : IMAGE_NONE;
+        record.next_sibling = entry.last ? IMAGE_NONE : (uint32_t)(count + 1);
+        next += record.child_count;
+
+        //append the strings, sharing the date with the previous record when it is the same
+        if (strings.size() + record.name_length + sizeof(date) >= IMAGE_NONE || next >= IMAGE_NONE) {
+            fclose(out);
+            remove(temp_name.c_str());
+            throw runtime_error("The VFS is too large for the image format");
+        }
+        record.name_offset = strings.size();
+        strings.append(name, record.name_length);
+        if (!have_date || last_date != date) {
+            have_date = true;
+            last_date = date;
+            last_date_offset = strings.size();
+            strings.append(reinterpret_cast<const char*>(&date), sizeof(date));
+        }
+        record.date_offset = last_date_offset;
+        record.date_length = sizeof(date);
+
+        records.append(reinterpret_cast<const char*>(&record), sizeof(record));
+        count++;
+        if (records.size() >= IO_CHUNK) {
+            ok = fwrite(records.data(), 1, records.size(), out) == records.size();
+            records.clear();
+        }
+    }
+
+    //the paths of the items of the bin go to the string table, their table follows it
+    string bin_items;
+    for (int i = 0; i < bin.length(); ++i) {
+        BinRecord& item = bin.at(i);
+        if (!item.live) { continue; }
+        ImageBinItem entry;
+        entry.record = 1 + bin_items.size() / sizeof(ImageBinItem);
+        entry.parent = (item.parent != nullptr) ? *parents.find(item.parent) : IMAGE_NONE;
+        entry.path_offset = strings.size();
+        entry.path_length = item.path.length();
+        strings += item.path;
+        bin_items.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    }
+    if (strings.size() >= IMAGE_NONE) {
+        fclose(out);
+        remove(temp_name.c_str());
+        throw runtime_error("The VFS is too large for the image format");
+    }
+
+    //write the remaining records, the string table and the bin table, then the final header
+    header.count = count;
+    header.strings_offset = sizeof(header) + count * sizeof(ImageRecord);
+    header.strings_size = strings.size();
+    strings.resize((strings.size() + 7) & ~(size_t)7, '\0');
+    header.bin_offset = header.strings_offset + strings.size();
+    header.bin_count = bin_items.size() / sizeof(ImageBinItem);
+    header.bin_max_items = bin_max_items;
+    header.bin_max_bytes = bin_max_bytes;
+    header.checkpoint = checkpoint;
+    ok = ok && fwrite(records.data(), 1, records.size(), out) == records.size();
+    ok = ok && fwrite(strings.data(), 1, strings.size(), out) == strings.size();
+    ok = ok && fwrite(bin_items.data(), 1, bin_items.size(), out) == bin_items.size();
+    ok = ok && fseek(out, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, out) == 1;
+    //the journal is emptied once the image is in place, so the image must be on disk before
+    ok = ok && fflush(out) == 0 && fsync(fileno(out)) == 0;
+    ok = (fclose(out) == 0) && ok;
+    if (!ok || rename(temp_name.c_str(), filename.c_str()) != 0) {
+        remove(temp_name.c_str());
+        throw runtime_error("Cannot save the VFS to " + filename);
+    }
+    //and so must the rename
+    size_t slash = filename.rfind('/');
+    string folder = (slash == string::npos) ? "." : filename.substr(0, slash + 1);
+    int dir = open(folder.c_str(), O_RDONLY | O_CLOEXEC);
+    if (dir >= 0) {
+        fsync(dir);
+        close(dir);
+    }
+}
+
+//Function to start a new checkpoint: the image is saved with a new checkpoint number and the journal,
+//whose changes are all in the image now, starts over for that number
+void VFS::save_checkpoint() {
+    //a random number, so that a journal left by another copy of the files is never taken for this one
+    random_device device;
+    uint64_t next;
+    do {
+        next = ((uint64_t)device() << 32) ^ device() ^ (uint64_t)chrono::steady_clock::now().time_since_epoch().count();
+    } while (next == 0 || next == checkpoint_id);
+    save_image(VFS_IMAGE, next);
+    checkpoint_id = next;
+    journal.reset(next);
+    compact_names();
+}
+
+//Function to drop the names no Inode uses anymore. The string pool and the pattern index are only ever added
+//to, so once most of their names are gone (removed, renamed) they are built again from the live Inodes, those
+//of the bin and of the subtrees waiting to be reclaimed included. The caller holds the tree lock for writing,
+//so no reader holds a Name; the flat copy does, it is dropped
+void VFS::compact_names() {
+    lock_guard<mutex> flat_guard(flat_lock);
+    lock_guard<mutex> guard(pool_lock);
+    if (names.size() <= 2 * by_name.size() + NAMES_COMPACT_MIN) { return; }
+    StringPool fresh;
+    patterns.clear();
+    by_name.clear();
+    inodes.for_each([&](Inode* inode) {
+        int before = fresh.size();
+        inode->name = fresh.intern(inode->name.data(), inode->name.length());
+        if (fresh.size() != before) { patterns.insert(inode->name); }
+        index_name(inode);
+    });
+    //the old names are freed with fresh
+    names.swap(fresh);
+    flat.clear();
+    tree_version++;
+}
+
+//Function to save the tree and empty the journal
+void VFS::checkpoint(Session& session) {
+    ostream& out = *session.out;
+    unsigned long long bytes = journal.size();
+    save_checkpoint();
+    out << "Saved " << VFS_IMAGE << ", " << bytes << " bytes of journal emptied" << endl;
+}
+
+//Function to show or set how the changes are journaled: off, async (group commit every few milliseconds)
+//or sync (every change is on disk before its command returns)
+void VFS::journal_mode(Session& session, string mode) {
+    ostream& out = *session.out;
+    if (!mode.empty()) {
+        JournalMode next;
+        if (mode == "off") { next = JOURNAL_OFF; }
+        else if (mode == "async") { next = JOURNAL_ASYNC; }
+        else if (mode == "sync") { next = JOURNAL_SYNC; }
+        else { throw runtime_error("Invalid journal mode. Use 'journal [off|async|sync]'."); }
+        //the changes made while it was off are not in the journal, the image must hold them before it goes on
+        bool resume = journal.mode() == JOURNAL_OFF && next != JOURNAL_OFF;
+        journal.set_mode(next);
+        if (resume) {
+            save_checkpoint();
+            //it could not be opened at startup, the new checkpoint lets it start empty
+            if (!journal.is_open()) {
+                try {
+                    journal.open(VFS_JOURNAL, checkpoint_id, [](const JournalRecord&) {});
+                } catch (exception &e) {
+                    journal.set_mode(JOURNAL_OFF);
+                    throw;
+                }
+            }
+        }
+    }
+    static const char* const NAMES[] = { "off", "async", "sync" };
+    unsigned long long records, syncs, bytes;
+    bool broken;
+    journal.statistics(records, syncs, bytes, broken);
+    out << "Journal: " << NAMES[journal.mode()] << ", " << records << " change(s) and " << bytes << " bytes since the checkpoint, "
+        << syncs << " sync(s)";
+    if (syncs > 0) { out << " (" << fixed << setprecision(1) << (double)records / syncs << " changes per sync)"; }
+    out << endl;
+    if (broken) { out << "The journal could not be written, use checkpoint to save the tree" << endl; }
+}
+
+//Function to write out the records the journal still holds in memory and stop its flusher. The program
+//ends with std::exit, which skips the destructors, so it calls this first or the last changes are lost
+void VFS::close_journal() {
+    WriteGuard guard(tree_lock);
+    journal.close();
+}
+
+//Function to record a change in the journal, the caller holds the tree lock for writing
+void VFS::log_change(const JournalRecord& change) {
+    last_record = journal.append(change);
+}
+
+//Function to redo a change of the journal. The paths are absolute, the session only receives the output
+void VFS::replay(Session& session, const JournalRecord& change) {
+    if (change.op == J_MKDIR || change.op == J_TOUCH) {
+        //the creation time of the original command is kept, older journals have it as a date
+        int64_t created = (int64_t)change.other_number;
+        if (!change.other.empty() && !parse_date(change.other.data(), change.other.length(), created)) { created = 0; }
+        size_t slash = change.path.rfind('/');
+        if (slash == string::npos) { throw runtime_error("Wrong path in the journal: " + change.path); }
+        Inode* parent = getNode(root, slash == 0 ? "/" : change.path.substr(0, slash));
+        string name = change.path.substr(slash + 1);
+        if (parent == nullptr || parent->type != Folder || !correct_name(name) || repeated_name(parent, name)) {
+            throw runtime_error("Cannot create " + change.path + " again");
+        }
+        Inode* inode = (change.op == J_MKDIR) ? new_inode(name, parent, Folder, 10, created)
+                                              : new_inode(name, parent, File, (unsigned int)change.number, created);
+        link_child(parent, inode);
+    }
+    else if (change.op == J_RM)				rm(session, change.path);
+    else if (change.op == J_MV)				mv(session, change.path, change.other);
+    else if (change.op == J_CP) {
+        Inode* source = getNode(root, change.path);
+        Inode* folder = getNode(root, change.other);
+        if (source == nullptr || folder == nullptr || folder->type != Folder) { throw runtime_error("Cannot copy " + change.path + " again"); }
+        copy_subtree(source, folder, (int64_t)change.other_number);
+    }
+    else if (change.op == J_RECOVER)		recover(session, change.path);
+    else if (change.op == J_EMPTYBIN)		emptybin(session);
+    else if (change.op == J_BINLIMIT) {
+        bin_max_items = (int)change.number;
+        bin_max_bytes = change.other_number;
+        purge_bin();
+    }
+}
+
+//Function to list the snapshots, take one, or drop one. Taking a snapshot copies nothing, the Inodes
+//keep their old state in it when they change afterwards
+void VFS::snapshot(Session& session, string name, string mode) {
+    ostream& out = *session.out;
+    if (!mode.empty() && mode != "drop") {
+        throw runtime_error("Invalid option. Either use 'snapshot [name]' or 'snapshot <name> drop'.");
+    }
+    if (name.empty()) {
+        if (snapshots.empty()) { out << "No snapshots" << endl; return; }
+        for (int i = 0; i < snapshots.size(); ++i) {
+            Snapshot* view = snapshots[i];
+            out << "@" << view->name << "  taken " << view->taken << ", " << view->frozen.size() << " Inode(s) kept, "
+                << view->kept_children << " children kept" << endl;
+        }
+        if (!retired.empty()) { out << retired.size() << " emptied subtree(s) kept for the snapshots" << endl; }
+        return;
+    }
+    Snapshot* existing = find_snapshot(name);
+    if (mode == "drop") {
+        if (existing == nullptr) { throw runtime_error("No snapshot named " + name); }
+        drop_snapshot(existing);
+        out << "Dropped @" << name << endl;
+        return;
+    }
+    if (!correct_name(name)) {
+        throw runtime_error("Wrong naming. Snapshot names can't be empty and should be alphanumeric only, except the period “.”.");
+    }
+    if (existing != nullptr) { throw runtime_error("A snapshot named " + name + " already exists"); }
+    Snapshot* taken = new Snapshot(name, ++snapshot_clock, format_date(currentTime()));
+    taken->slot = snapshots.size();
+    snapshots.push_back(taken);
+    out << "Took snapshot @" << name << endl;
+}
+
+//Function to find a snapshot by its name, nullptr if there is none
+Snapshot* VFS::find_snapshot(const string& name) {
+    for (int i = 0; i < snapshots.size(); ++i) {
+        if (snapshots[i]->name == name) { return snapshots[i]; }
+    }
+    return nullptr;
+}
+
+//Function to drop a snapshot. The previous snapshot saw the Inodes it didn't keep itself through this one,
+//so it takes over what this one kept. The emptied subtrees no snapshot can see anymore are freed
+void VFS::drop_snapshot(Snapshot* view) {
+    for (int i = 0; i < sessions.size(); ++i) {
+        if (sessions[i]->snapshot == view) { throw runtime_error("A session is in @" + view->name + ", it can't be dropped"); }
+    }
+    for (int i = 0; i < sessions.size(); ++i) {
+        if (sessions[i]->prev_snapshot == view) {
+            sessions[i]->prev = nullptr;
+            sessions[i]->prev_snapshot = nullptr;
+        }
+    }
+    if (view->slot > 0) {
+        Snapshot* older = snapshots[view->slot - 1];
+        view->frozen.for_each([&](Inode* inode, Frozen& state) {
+            Frozen& kept = older->frozen[inode];
+            if (state.has_state && !kept.has_state) {
+                kept.parent = state.parent;
+                kept.total = state.total;
+                kept.has_state = true;
+            }
+            if (state.has_children && !kept.has_children) {
+                kept.children = std::move(state.children);
+                kept.has_children = true;
+                older->kept_children += kept.children.size();
+            }
+        });
+    }
+    snapshots.erase(view->slot);
+    for (int i = view->slot; i < snapshots.size(); ++i) { snapshots[i]->slot = i; }
+    delete view;
+
+    //the subtrees emptied while only the dropped snapshots existed can go
+    int kept = 0;
+    for (int i = 0; i < retired.size(); ++i) {
+        if (!snapshots.empty() && snapshots[0]->id <= retired[i].seen_by) { retired[kept++] = retired[i]; }
+        else { free_subtree(retired[i].subtree); }
+    }
+    while (retired.size() > kept) { retired.pop_back(); }
+}
+
+//Function to show or set the number of threads of the whole-tree operations (find scan, size verify)
+void VFS::threads(Session& session, string count) {
+    ostream& out = *session.out;
+    if (!count.empty()) {
+        if (count.find_first_not_of("0123456789") != string::npos) {
+            throw runtime_error("Invalid number of threads. Use 'threads [count]', 0 for one per core.");
+        }
+        walker.set_threads(stoi(count));
+    }
+    out << "Threads: " << walker.threads() << endl;
+}
+
+//Function to time a full recount of a subtree with 1, 2, 4... threads up to the number of cores
+void VFS::bench(Session& session, string path, string levels) {
+    ostream& out = *session.out;
+    if (path == "deep") {
+        bench_deep(session, levels.empty() ? BENCH_DEEP_LEVELS : stoi(levels));
+        return;
+    }
+    if (path == "ls") {
+        bench_ls(session);
+        return;
+    }
+    if (path == "simd") {
+        bench_simd(session);
+        return;
+    }
+    if (path == "scan") {
+        bench_scan(session, levels);
+        return;
+    }
+    if (path == "vector") {
+        bench_vector(session, levels.empty() ? BENCH_VECTOR_COUNT : stoi(levels));
+        return;
+    }
+    if (path == "fanout") {
+        bench_fanout(session, levels.empty() ? BENCH_FANOUT_MAX : stoi(levels));
+        return;
+    }
+    if (path == "cp") {
+        bench_cp(session, levels.empty() ? BENCH_CP_COUNT : stoi(levels));
+        return;
+    }
+    if (path == "create") {
+        bench_create(session, levels.empty() ? BENCH_CREATE_COUNT : stoi(levels));
+        return;
+    }
+    if (path == "journal") {
+        bench_journal(session, levels.empty() ? BENCH_JOURNAL_COUNT : stoi(levels));
+        return;
+    }
+    Inode* inode = path.empty() ? session.cwd : getNode(session.cwd, path);
+    if (inode == nullptr) { throw runtime_error("The path doesn't exist"); }
+    //materialize the subtree first so that every run measures the same work
+    materialize(inode);
+    int configured = walker.threads();
+    int cores = (int)thread::hardware_concurrency();
+    if (cores < 1) { cores = 1; }
+    unsigned long long nodes = 0;
+    walker.set_threads(1);
+    walk(inode, [&](Inode* node, int) -> Vector<Inode*>* { nodes++; return node->type == Folder ? &node->children : nullptr; });
+    double base = 0;
+    for (int count = 1; ; count = (count * 2 > cores && count < cores) ? cores : count * 2) {
+        walker.set_threads(count);
+        int mismatches = 0;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        getSize(inode, &mismatches);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (count == 1) { base = seconds; }
+        out << setw(4) << count << " thread(s): " << fixed << setprecision(3) << seconds * 1000 << " ms, "
+             << setprecision(1) << nodes / seconds / 1e6 << " M Inodes/s, speedup " << setprecision(2) << base / seconds << endl;
+        out.unsetf(ios::floatfield);
+        if (count >= cores) { break; }
+    }
+    walker.set_threads(configured);
+}
+
+//Function to time the creation of files in a temporary folder of the root, the way touch creates them
+//(creation time, Inode, links), then free them
+void VFS::bench_create(Session& session, int count) {
+    ostream& out = *session.out;
+    if (count < 1) { throw runtime_error("The number of files must be positive"); }
+    if (lookup(root, BENCH_DEEP_NAME) != nullptr) { throw runtime_error("A folder named " BENCH_DEEP_NAME " already exists in /"); }
+    Inode* top = new_inode(BENCH_DEEP_NAME, root, Folder, 0, currentTime());
+    link_child(root, top);
+    //the names are made first, only the creation is timed
+    Vector<string> file_names(count);
+    for (int i = 0; i < count; ++i) { file_names.push_back("f" + to_string(i)); }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        link_child(top, new_inode(file_names[i], top, File, 1, currentTime()));
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    unlink_child(root, top);
+    reclaim(top);
+    out << count << " files in " << fixed << setprecision(3) << seconds * 1000 << " ms, " << setprecision(0)
+        << count / seconds << " creates/s, " << sizeof(Inode) << " bytes per Inode" << endl;
+    out.unsetf(ios::floatfield);
+}
+
+//Function to time touch in a temporary folder with the journal off, async and sync. Like execute, sync waits
+//for every change to be on disk and async for the group commit of the last one only. The journal then holds
+//files of a folder it never saw made, so a checkpoint starts it over
+void VFS::bench_journal(Session& session, int count) {
+    ostream& out = *session.out;
+    if (count < 100) { throw runtime_error("The number of files must be at least 100"); }
+    if (!journal.is_open()) { throw runtime_error("The journal is not open, use journal async to open it"); }
+    if (lookup(root, BENCH_DEEP_NAME) != nullptr) { throw runtime_error("A folder named " BENCH_DEEP_NAME " already exists in /"); }
+    static const char* const NAMES[] = { "off", "async", "sync" };
+    //the names are made first, only the changes are timed
+    Vector<string> file_names(count);
+    for (int i = 0; i < count; ++i) { file_names.push_back("f" + to_string(i)); }
+    JournalMode configured = journal.mode();
+    out << left << setw(10) << "journal" << right << setw(10) << "files" << setw(12) << "ms" << setw(14) << "touch/s" << endl;
+    for (int mode = JOURNAL_OFF; mode <= JOURNAL_SYNC; ++mode) {
+        //every change waits for a sync of its own there
+        int files = mode == JOURNAL_SYNC ? count / 100 : count;
+        Inode* top = new_inode(BENCH_DEEP_NAME, root, Folder, 0, currentTime());
+        link_child(root, top);
+        Session bench(top, out);
+        journal.set_mode((JournalMode)mode);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        try {
+            for (int i = 0; i < files; ++i) {
+                touch(bench, file_names[i], 1);
+                if (mode == JOURNAL_SYNC) { journal.wait(last_record); }
+            }
+            if (mode == JOURNAL_ASYNC) { journal.wait(last_record); }
+        } catch (exception &e) {
+            //the journal could not be written, leave the tree and the mode as they were
+            unlink_child(root, top);
+            reclaim(top);
+            journal.set_mode(configured);
+            throw;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        unlink_child(root, top);
+        reclaim(top);
+        out << left << setw(10) << NAMES[mode] << right << setw(10) << files << fixed << setprecision(1) << setw(12)
+            << seconds * 1000 << setprecision(0) << setw(14) << files / seconds << endl;
+    }
+    out.unsetf(ios::floatfield);
+    journal.set_mode(configured);
+    save_checkpoint();
+}
+
+//Times the steps of bench vector on a container type, in milliseconds: count ints pushed without reserve (the
+//growth), a sum over them, count / 10 strings pushed (moved at each growth) and count / 10 lists of 3 pointers,
+//the usual size of a folder, made and dropped one after the other
+template <typename Ints, typename Strings, typename Pointers>
+static void time_containers(int count, double ms[4], volatile long long& sink) {
+    typedef chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    {
+        Ints ints;
+        for (int i = 0; i < count; ++i) { ints.push_back(i); }
+        ms[0] = chrono::duration<double, milli>(Clock::now() - start).count();
+        start = Clock::now();
+        long long sum = 0;
+        for (auto it = ints.begin(); it != ints.end(); ++it) { sum += *it; }
+        ms[1] = chrono::duration<double, milli>(Clock::now() - start).count();
+        sink = sink + sum;
+    }
+    string texts[3] = { string(32, 'x'), string(32, 'y'), string(32, 'z') };
+    start = Clock::now();
+    {
+        Strings strings;
+        for (int i = 0; i < count / 10; ++i) { strings.push_back(texts[0]); }
+        sink = sink + strings.size();
+    }
+    ms[2] = chrono::duration<double, milli>(Clock::now() - start).count();
+    start = Clock::now();
+    for (int i = 0; i < count / 10; ++i) {
+        Pointers pointers;
+        pointers.push_back(&texts[0]);
+        pointers.push_back(&texts[i % 3]);
+        pointers.push_back(&texts[2]);
+        sink = sink + pointers[1]->length();
+    }
+    ms[3] = chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+//Function to time Vector against std::vector on the same work
+void VFS::bench_vector(Session& session, int count) {
+    ostream& out = *session.out;
+    if (count < 10) { throw runtime_error("The count must be at least 10"); }
+    double mine[4], standard[4];
+    //the results go to a volatile so that the timed work is not optimized away
+    volatile long long sink = 0;
+    //each twice, the first run warms the allocator up
+    for (int run = 0; run < 2; ++run) {
+        time_containers<Vector<int>, Vector<string>, Vector<string*> >(count, mine, sink);
+        time_containers<vector<int>, vector<string>, vector<string*> >(count, standard, sink);
+    }
+    const char* steps[4] = { "push_back int", "iterate int", "push_back string", "lists of 3" };
+    out << setw(18) << "" << setw(12) << "Vector ms" << setw(14) << "std::vector" << endl;
+    for (int i = 0; i < 4; ++i) {
+        out << left << setw(18) << steps[i] << right << fixed << setprecision(1) << setw(12) << mine[i] << setw(14)
+            << standard[i] << endl;
+    }
+    out.unsetf(ios::floatfield);
+}
+
+//Function to time the creation of files and the lookup of names in folders of 1000, 10000... children up to max.
+//The files are created with the checks of touch (valid, not repeated) and without the journal. The lookups
+//go through the hash index of the folder; a sample of them also scans the children, as before the index
+void VFS::bench_fanout(Session& session, int max) {
+    ostream& out = *session.out;
+    if (max < 1000) { throw runtime_error("The largest folder must have at least 1000 entries"); }
+    if (lookup(root, BENCH_DEEP_NAME) != nullptr) { throw runtime_error("A folder named " BENCH_DEEP_NAME " already exists in /"); }
+    typedef chrono::steady_clock Clock;
+    //the names are made first, only the work on the folder is timed
+    Vector<string> file_names(max);
+    Vector<string> missing(max);
+    for (int i = 0; i < max; ++i) {
+        file_names.push_back("f" + to_string(i) + ".txt");
+        missing.push_back("m" + to_string(i) + ".txt");
+    }
+    //the names are looked up in a random order, so that consecutive lookups don't share cache lines
+    mt19937 random(12345);
+    out << setw(10) << "children" << setw(12) << "create ns" << setw(12) << "lookup ns" << setw(12) << "miss ns"
+        << setw(12) << "scan ns" << setw(12) << "remove ns" << endl;
+    for (int count = 1000; count <= max; count = (count <= max / 10) ? count * 10 : (count < max ? max : max + 1)) {
+        Inode* folder = new_inode(BENCH_DEEP_NAME, root, Folder, 10, currentTime());
+        link_child(root, folder);
+
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < count; ++i) {
+            if (!correct_name(file_names[i]) || repeated_name(folder, file_names[i])) { throw runtime_error("Wrong name " + file_names[i]); }
+            link_child(folder, new_inode(file_names[i], folder, File, 1, currentTime()));
+        }
+        double create = chrono::duration<double, nano>(Clock::now() - start).count() / count;
+
+        Vector<int> order(count);
+        for (int i = 0; i < count; ++i) { order.push_back(i); }
+        shuffle(order.data(), order.data() + count, random);
+        int found = 0;
+        start = Clock::now();
+        for (int i = 0; i < count; ++i) { found += lookup(folder, file_names[order[i]]) != nullptr; }
+        double hit = chrono::duration<double, nano>(Clock::now() - start).count() / count;
+        start = Clock::now();
+        for (int i = 0; i < count; ++i) { found += lookup(folder, missing[order[i]]) != nullptr; }
+        double miss = chrono::duration<double, nano>(Clock::now() - start).count() / count;
+
+        int scans = min(count, BENCH_FANOUT_SCANS);
+        start = Clock::now();
+        for (int i = 0; i < scans; ++i) {
+            const string& name = file_names[order[i]];
+            for (int c = 0; c < folder->children.size(); ++c) {
+                if (folder->children[c]->name == name) { found++; break; }
+            }
+        }
+        double scan = chrono::duration<double, nano>(Clock::now() - start).count() / scans;
+        if (found != count + scans) { throw runtime_error("Lookups went wrong in a folder of " + to_string(count)); }
+
+        //the files are unlinked in the random order, the way rm takes them out of the folder
+        Vector<Inode*> removed(count);
+        for (int i = 0; i < count; ++i) { removed.push_back(folder->index.find(file_names[order[i]])); }
+        start = Clock::now();
+        for (int i = 0; i < count; ++i) { unlink_child(folder, removed[i]); }
+        double remove = chrono::duration<double, nano>(Clock::now() - start).count() / count;
+        if (!folder->children.empty() || folder->index.size() != 0 || folder->total != 10) {
+            throw runtime_error("Removals went wrong in a folder of " + to_string(count));
+        }
+
+        for (int i = 0; i < count; ++i) { reclaim(removed[i]); }
+        unlink_child(root, folder);
+        reclaim(folder);
+        out << setw(10) << count << fixed << setprecision(1) << setw(12) << create << setw(12) << hit << setw(12) << miss
+            << setw(12) << scan << setw(12) << remove << endl;
+        out.unsetf(ios::floatfield);
+    }
+}
+
+//Function to time cp -r and mv of a folder on a temporary subtree of count Inodes (folders of BENCH_CP_FANOUT
+//files), after creating it one Inode at a time the way mkdir and touch do. The totals are checked at the end
+void VFS::bench_cp(Session& session, int count) {
+    ostream& out = *session.out;
+    if (count < 2) { throw runtime_error("The number of Inodes must be at least 2"); }
+    if (lookup(root, BENCH_DEEP_NAME) != nullptr) { throw runtime_error("A folder named " BENCH_DEEP_NAME " already exists in /"); }
+    typedef chrono::steady_clock Clock;
+    Inode* top = new_inode(BENCH_DEEP_NAME, root, Folder, 10, currentTime());
+    link_child(root, top);
+    Inode* source = new_inode("source", top, Folder, 10, currentTime());
+    Inode* target = new_inode("target", top, Folder, 10, currentTime());
+    Inode* moved = new_inode("moved", top, Folder, 10, currentTime());
+    link_child(top, source);
+    link_child(top, target);
+    link_child(top, moved);
+    //the names are made first, only the creation is timed
+    Vector<string> file_names(BENCH_CP_FANOUT);
+    for (int i = 0; i < BENCH_CP_FANOUT; ++i) { file_names.push_back("f" + to_string(i) + ".txt"); }
+
+    Clock::time_point start = Clock::now();
+    Inode* folder = nullptr;
+    for (int i = 0; i < count - 1; ++i) {
+        int slot = i % (BENCH_CP_FANOUT + 1);
+        if (slot == 0) {
+            folder = new_inode("d" + to_string(i / (BENCH_CP_FANOUT + 1)), source, Folder, 10, currentTime());
+            link_child(source, folder);
+        } else {
+            link_child(folder, new_inode(file_names[slot - 1], folder, File, 1, currentTime()));
+        }
+    }
+    double created = chrono::duration<double>(Clock::now() - start).count();
+
+    start = Clock::now();
+    copy_subtree(source, target, currentTime());
+    double copied = chrono::duration<double>(Clock::now() - start).count();
+
+    //the steps of mv for a folder
+    start = Clock::now();
+    unlink_child(top, source);
+    link_child(moved, source);
+    double move = chrono::duration<double>(Clock::now() - start).count();
+
+    int mismatches = 0;
+    getSize(top, &mismatches);
+    unlink_child(root, top);
+    reclaim(top);
+    out << count << " Inodes: created one by one in " << fixed << setprecision(1) << created * 1000 << " ms ("
+        << setprecision(0) << count / created << "/s), copied by cp -r in " << setprecision(1) << copied * 1000 << " ms ("
+        << setprecision(0) << count / copied << "/s), moved by mv in " << setprecision(1) << move * 1e6 << " us, "
+        << mismatches << " total(s) out of sync" << endl;
+    out.unsetf(ios::floatfield);
+}
+
+//Function to time the whole-tree recount and a find by pattern (default *.txt) on the Inodes and on the flat copy
+void VFS::bench_scan(Session& session, string pattern) {
+    ostream& out = *session.out;
+    if (pattern.empty()) { pattern = "*.txt"; }
+    pattern = unquote(pattern);
+    materialize(root);
+    typedef chrono::steady_clock Clock;
+    int mismatches = 0;
+    Vector<string> paths;
+    Clock::time_point start = Clock::now();
+    unsigned long long walked = getSize(root, &mismatches);
+    double walk_size = chrono::duration<double>(Clock::now() - start).count();
+    start = Clock::now();
+    find_helper(root, pattern, paths);
+    double walk_find = chrono::duration<double>(Clock::now() - start).count();
+    int walk_hits = paths.size();
+
+    start = Clock::now();
+    flatten();
+    double copy = chrono::duration<double>(Clock::now() - start).count();
+    mismatches = 0;
+    start = Clock::now();
+    unsigned long long scanned = flat.recount(&mismatches);
+    double flat_recount = chrono::duration<double>(Clock::now() - start).count();
+    Vector<Inode*> hits;
+    start = Clock::now();
+    flat.find_glob(pattern, hits);
+    double flat_scan = chrono::duration<double>(Clock::now() - start).count();
+    if (walked != scanned || walk_hits != hits.size()) { throw runtime_error("The flat copy differs from the tree"); }
+
+    out << flat.count() << " Inodes, " << walk_hits << " match " << pattern << ", flat copy of " << flat.bytes() / 1024 << " KiB made in "
+        << fixed << setprecision(3) << copy * 1000 << " ms" << endl;
+    out << "Inodes (" << walker.threads() << " thread(s)): size verify " << walk_size * 1000 << " ms, find " << walk_find * 1000 << " ms" << endl;
+    out << "flat copy:     size verify " << flat_recount * 1000 << " ms, find " << flat_scan * 1000 << " ms" << endl;
+    out.unsetf(ios::floatfield);
+}
+
+//Function to time the name kernels at every level the CPU supports, on long buffers and on names of 12 bytes.
+//The speed is in bytes per cycle of the time stamp counter on x86, in bytes per nanosecond elsewhere
+void VFS::bench_simd(Session& session) {
+    ostream& out = *session.out;
+    const size_t long_length = 64 << 10, short_length = 12, rounds = 1024;
+    string text(long_length, ' '), copy;
+    for (size_t i = 0; i < long_length; ++i) { text[i] = "abcdefghijklmnopqrstuvwxyz0123456789"[(i * 7 + i / 36) % 36]; }
+    copy = text;
+    //the literal never occurs, the whole text is searched
+    const char literal[] = ".txt";
+    auto ticks = []() -> unsigned long long {
+#if defined(__x86_64__)
+        return __rdtsc();
+#else
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    };
+    int count;
+    const SimdKernels* levels = simd_levels(count);
+#if defined(__x86_64__)
+    const char* unit = "cycle";
+#else
+    const char* unit = "ns";
+#endif
+    out << "level    kernel      " << setw(12) << "64 KiB" << setw(12) << "12 bytes" << "   (bytes per " << unit
+        << ", active " << simd->level << ")" << endl;
+    volatile size_t sink = 0;
+    for (int l = 0; l < count; ++l) {
+        const SimdKernels& k = levels[l];
+        for (int kernel = 0; kernel < 3; ++kernel) {
+            double speed[2];
+            for (int size = 0; size < 2; ++size) {
+                size_t length = size == 0 ? long_length : short_length;
+                size_t calls = size == 0 ? rounds : rounds * long_length / short_length;
+                unsigned long long start = ticks();
+                for (size_t c = 0; c < calls; ++c) {
+                    //the short inputs move through the text so that they are not always the same bytes
+                    size_t at = size == 0 ? 0 : (c * short_length) % (long_length - short_length);
+                    size_t dots = 0;
+                    if (kernel == 0) { sink = sink + k.charset(text.data() + at, length, dots) + dots; }
+                    else if (kernel == 1) { sink = sink + k.equal(text.data() + at, copy.data() + at, length); }
+                    else { sink = sink + k.contains(text.data() + at, length, literal, sizeof(literal) - 1); }
+                }
+                unsigned long long elapsed = ticks() - start;
+                speed[size] = (double)calls * length / (elapsed > 0 ? elapsed : 1);
+            }
+            out << left << setw(9) << (kernel == 0 ? k.level : "") << setw(12) << (kernel == 0 ? "charset" : kernel == 1 ? "equal" : "contains")
+                << right << fixed << setprecision(2) << setw(12) << speed[0] << setw(12) << speed[1] << endl;
+        }
+    }
+    out.unsetf(ios::floatfield);
+}
+
+//Function to time the rows of ls for the current folder, formatted with the manipulators of iostream and
+//with the row formatter of ls, both into memory
+void VFS::bench_ls(Session& session) {
+    ostream& out = *session.out;
+    Vector<Inode*>& children = children_in(session.snapshot, session.cwd);
+    if (children.size() == 0) { throw runtime_error("The current folder is empty"); }
+    ostringstream manipulated, formatted;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < children.size(); ++i) {
+        Inode* current = children[i];
+        manipulated << (current->type == File ? "File" : "dir") << setw(15) << current->name << setw(15) << format_date(current->created) << setw(10) << current->size << "bytes" << endl;
+    }
+    double iostream_time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    start = chrono::steady_clock::now();
+    print_rows(formatted, children.data(), children.size(), 15);
+    double row_time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (manipulated.str() != formatted.str()) { throw runtime_error("The two listings differ"); }
+    out << children.size() << " rows, " << formatted.str().length() << " bytes" << endl;
+    out << "iostream:      " << fixed << setprecision(3) << iostream_time * 1000 << " ms, " << setprecision(1) << children.size() / iostream_time / 1e6 << " M rows/s" << endl;
+    out << "row formatter: " << setprecision(3) << row_time * 1000 << " ms, " << setprecision(1) << children.size() / row_time / 1e6 << " M rows/s" << endl;
+    out.unsetf(ios::floatfield);
+}
+
+//Function to time find on a chain of folders levels deep, with a file named leaf at every level, so that
+//the hits have paths of every length up to the depth. The chain is built under the root and freed afterwards
+void VFS::bench_deep(Session& session, int levels) {
+    ostream& out = *session.out;
+    if (levels < 1) { throw runtime_error("The number of levels must be positive"); }
+    if (lookup(root, BENCH_DEEP_NAME) != nullptr) { throw runtime_error("A folder named " BENCH_DEEP_NAME " already exists in /"); }
+    int64_t date = currentTime();
+    Inode* top = new_inode(BENCH_DEEP_NAME, root, Folder, 0, date);
+    link_child(root, top);
+    Inode* folder = top;
+    for (int i = 0; i < levels; ++i) {
+        link_child(folder, new_inode("leaf", folder, File, 1, date));
+        Inode* next = new_inode("level", folder, Folder, 0, date);
+        link_child(folder, next);
+        folder = next;
+    }
+
+    //scan of the chain, then the hits through the name index (which may also hold leaf files of the tree)
+    Vector<string> scanned, indexed;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    find_helper(top, "leaf", scanned);
+    double scan = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    Name leaf;
+    {
+        lock_guard<mutex> guard(pool_lock);
+        names.find("leaf", leaf);
+    }
+    start = chrono::steady_clock::now();
+    find_paths(leaf, indexed);
+    double index = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    unsigned long long bytes = 0;
+    for (int i = 0; i < scanned.size(); ++i) { bytes += scanned[i].length(); }
+
+    unlink_child(root, top);
+    reclaim(top);
+    out << levels << " levels, " << scanned.size() << " hits, " << bytes << " bytes of paths" << endl;
+    out << "find scan:  " << fixed << setprecision(3) << scan * 1000 << " ms, " << setprecision(1) << bytes / scan / 1e6 << " MB/s of paths" << endl;
+    out << "find index: " << setprecision(3) << index * 1000 << " ms, " << indexed.size() << " hits" << endl;
+    out.unsetf(ios::floatfield);
+}
+
+//Function to run the behaviour checks of the data structures, all of them or those of one area. Each area works
+//in a temporary folder of the root, removed afterwards, and stops at the first expectation that is not met. While
+//snapshots are taken, the temporary Inodes wait for them to be dropped like any subtree removed meanwhile
+void VFS::check(Session& session, string area) {
+    ostream& out = *session.out;
+    typedef void (VFS::*Check)(Inode* folder, Expect& expect);
+    struct Area { const char* name; Check run; };
+    static const Area AREAS[] = {
+        { "index", &VFS::check_index }, { "vector", &VFS::check_vector }, { "walker", &VFS::check_walker },
+        { "journal", &VFS::check_journal }, { "snapshot", &VFS::check_snapshot }, { "paths", &VFS::check_paths },
+        { "paging", &VFS::check_paging }, { "flat", &VFS::check_flat }, { "glob", &VFS::check_glob }
+    };
+    const int count = sizeof(AREAS) / sizeof(AREAS[0]);
+    bool known = area.empty();
+    string names;
+    for (int i = 0; i < count; ++i) {
+        if (area == AREAS[i].name) { known = true; }
+        names += (i == 0 ? "" : "|") + string(AREAS[i].name);
+    }
+    if (!known) { throw runtime_error("Unknown area. Use 'check [" + names + "]'."); }
+    if (lookup(root, CHECK_FOLDER) != nullptr) { throw runtime_error("A folder named " CHECK_FOLDER " already exists in /"); }
+    for (int i = 0; i < count; ++i) {
+        if (!area.empty() && area != AREAS[i].name) { continue; }
+        Inode* folder = new_inode(CHECK_FOLDER, root, Folder, 0, currentTime());
+        link_child(root, folder);
+        Expect expect(AREAS[i].name);
+        try {
+            (this->*AREAS[i].run)(folder, expect);
+        } catch (exception &e) {
+            unlink_child(root, folder);
+            reclaim(folder);
+            throw;
+        }
+        unlink_child(root, folder);
+        reclaim(folder);
+        out << left << setw(10) << AREAS[i].name << right << "ok, " << expect.met << " expectation(s) met" << endl;
+    }
+}
+
+//Checks the name index of a folder: removals leave tombstones that the lookups probe past, adding and
+//removing names over and over doesn't grow the table, and the children vector and the index stay in step
+void VFS::check_index(Inode* folder, Expect& expect) {
+    const int count = 1000;
+    Vector<Inode*> files(count);
+    for (int i = 0; i < count; ++i) {
+        Inode* file = new_inode("f" + to_string(i), folder, File, 1, currentTime());
+        link_child(folder, file);
+        files.push_back(file);
+    }
+    expect(folder->index.size() == count, "the index doesn't hold every child");
+    size_t bytes = folder->index.bytes();
+    //every other file goes, the others are behind their tombstones
+    for (int i = 0; i < count; i += 2) {
+        unlink_child(folder, files[i]);
+        reclaim(files[i]);
+    }
+    for (int i = 0; i < count; ++i) {
+        Inode* found = lookup(folder, "f" + to_string(i));
+        expect(found == (i % 2 == 0 ? nullptr : files[i]), "wrong lookup of f" + to_string(i) + " after the removals");
+    }
+    for (int round = 0; round < 20; ++round) {
+        Vector<Inode*> added(count / 2);
+        for (int i = 0; i < count / 2; ++i) {
+            Inode* file = new_inode("g" + to_string(round) + "_" + to_string(i), folder, File, 1, currentTime());
+            link_child(folder, file);
+            added.push_back(file);
+        }
+        for (int i = 0; i < added.size(); ++i) {
+            unlink_child(folder, added[i]);
+            reclaim(added[i]);
+        }
+    }
+    //a table full of tombstones would make a miss probe forever
+    expect(lookup(folder, "missing") == nullptr, "a missing name was found");
+    expect(folder->index.bytes() <= 2 * bytes, "the tombstones grew the table from " + to_string(bytes) + " to "
+           + to_string(folder->index.bytes()) + " bytes");
+    expect(folder->index.size() == folder->children.size(), "the index and the children disagree on the count");
+    for (int i = 0; i < folder->children.size(); ++i) {
+        Inode* child = folder->children[i];
+        expect(child->child_slot == i, "the slot of " + string(child->name.c_str()) + " is wrong");
+        expect(lookup(folder, child->name.data(), child->name.length()) == child, string(child->name.c_str()) + " is not indexed");
+    }
+}
+
+//Element of the Vector checks that counts the live objects, so that a leak or a double destruction shows
+struct Counted
+{
+    static int live;
+    int value;
+
+    Counted(int v = 0) : value(v) { live++; }
+    Counted(const Counted& other) : value(other.value) { live++; }
+    Counted(Counted&& other) : value(other.value) { other.value = -1; live++; }
+    Counted& operator=(const Counted& other) { value = other.value; return *this; }
+    Counted& operator=(Counted&& other) { value = other.value; other.value = -1; return *this; }
+    ~Counted() { live--; }
+};
+int Counted::live = 0;
+
+//Checks Vector: the first elements stay inline, growth moves them to the heap, moves leave the source empty
+//whether its elements were inline or not, copies are independent and every element is destroyed once
+void VFS::check_vector(Inode*, Expect& expect) {
+    Counted::live = 0;
+    {
+        Vector<Counted, 4> grown;
+        for (int i = 0; i < 3; ++i) { grown.push_back(Counted(i)); }
+        expect(grown.capacity() == 4, "3 elements left the inline buffer");
+        for (int i = 3; i < 10; ++i) { grown.emplace_back(i); }
+        expect(grown.capacity() > 4 && grown.size() == 10, "10 elements don't fit");
+        bool in_order = true;
+        for (int i = 0; i < 10; ++i) { in_order = in_order && grown[i].value == i; }
+        expect(in_order, "the growth moved the elements out of order");
+        expect(Counted::live == 10, "the growth left " + to_string(Counted::live) + " elements alive for 10");
+
+        Vector<Counted, 4> moved(std::move(grown));
+        expect(moved.size() == 10 && grown.size() == 0, "moving a vector from the heap didn't empty the source");
+        expect(moved[9].value == 9 && Counted::live == 10, "moving a vector from the heap lost elements");
+        Vector<Counted, 4> small;
+        small.push_back(Counted(7));
+        small.push_back(Counted(8));
+        Vector<Counted, 4> moved_small;
+        moved_small = std::move(small);
+        expect(moved_small.size() == 2 && small.size() == 0, "moving an inline vector didn't empty the source");
+        expect(moved_small[0].value == 7 && moved_small[1].value == 8, "moving an inline vector lost elements");
+        expect(Counted::live == 12, "the moves left " + to_string(Counted::live) + " elements alive for 12");
+
+        Vector<Counted, 4> copy(moved);
+        copy[0].value = 100;
+        expect(moved[0].value == 0 && copy.size() == 10, "a copy shares the elements of its source");
+        copy.erase(0);
+        copy.insert(1, Counted(50));
+        expect(copy.size() == 10 && copy[0].value == 1 && copy[1].value == 50 && copy[2].value == 2, "erase or insert broke the order");
+        copy.clear();
+        expect(Counted::live == 12, "clear left " + to_string(Counted::live) + " elements alive for 12");
+        while (moved.size() > 3) { moved.pop_back(); }
+        moved.shrink_to_fit();
+        expect(moved.size() == 3 && moved[2].value == 2, "shrink_to_fit lost elements");
+    }
+    expect(Counted::live == 0, to_string(Counted::live) + " elements outlived their vectors");
+    //strings long enough to own heap memory keep it through the growth
+    Vector<string> strings;
+    for (int i = 0; i < 100; ++i) { strings.push_back(string(40, 'a' + i % 26)); }
+    bool intact = true;
+    for (int i = 0; i < 100; ++i) { intact = intact && strings[i] == string(40, 'a' + i % 26); }
+    expect(intact, "the growth corrupted strings");
+}
+
+//Checks the parallel walker: with 1, 2, 4 and 8 threads a walk visits every Inode of a subtree once, and the
+//recount of size verify finds the cached totals right
+void VFS::check_walker(Inode* folder, Expect& expect) {
+    int nodes = 1;
+    for (int i = 0; i < 20; ++i) {
+        Inode* middle = new_inode("d" + to_string(i), folder, Folder, 10, currentTime());
+        link_child(folder, middle);
+        for (int j = 0; j < 20; ++j) {
+            Inode* inner = new_inode("d" + to_string(j), middle, Folder, 10, currentTime());
+            link_child(middle, inner);
+            for (int k = 0; k < 10; ++k) { link_child(inner, new_inode("f" + to_string(k), inner, File, k % 7 + 1, currentTime())); }
+            nodes += 11;
+        }
+        nodes++;
+    }
+    int configured = walker.threads();
+    try {
+        for (int threads = 1; threads <= 8; threads *= 2) {
+            walker.set_threads(threads);
+            Vector<Vector<Inode*> > seen(walker.threads());
+            for (int i = 0; i < walker.threads(); ++i) { seen.push_back(Vector<Inode*>()); }
+            walk(folder, [&](Inode* node, int worker) -> Vector<Inode*>* {
+                seen[worker].push_back(node);
+                return node->type == Folder ? &node->children : nullptr;
+            });
+            vector<Inode*> all;
+            for (int i = 0; i < seen.size(); ++i) { all.insert(all.end(), seen[i].data(), seen[i].data() + seen[i].size()); }
+            sort(all.begin(), all.end());
+            string label = " with " + to_string(threads) + " thread(s)";
+            expect((int)all.size() == nodes, "the walk visited " + to_string(all.size()) + " Inodes of " + to_string(nodes) + label);
+            expect(adjacent_find(all.begin(), all.end()) == all.end(), "the walk visited an Inode twice" + label);
+            int mismatches = 0;
+            expect(getSize(folder, &mismatches) == folder->total && mismatches == 0, "the recount disagrees with the totals" + label);
+        }
+    } catch (exception &e) {
+        walker.set_threads(configured);
+        throw;
+    }
+    walker.set_threads(configured);
+}
+
+//Checks the replay of a journal of its own, next to vfs.log: the records come back in order after each reopen,
+//a torn last record is cut off and the log goes on after it, a corrupt record ends the replay and a journal
+//of another checkpoint is not replayed
+void VFS::check_journal(Inode*, Expect& expect) {
+    string file = string(VFS_JOURNAL) + ".check";
+    unlink(file.c_str());
+    Journal log;
+    Vector<string> replayed;
+    auto collect = [&](const JournalRecord& change) { replayed.push_back(change.path + "," + to_string(change.number)); };
+    auto file_size = [&]() {
+        struct stat info;
+        return stat(file.c_str(), &info) == 0 ? (long long)info.st_size : -1;
+    };
+    //sizes[i] is the size of the journal holding the first i records
+    Vector<long long> sizes;
+    for (int i = 0; i <= 10; ++i) {
+        replayed.clear();
+        expect(log.open(file, 7, collect) == (unsigned long long)i, "reopening replayed " + to_string(replayed.size()) + " records of " + to_string(i));
+        bool in_order = true;
+        for (int j = 0; j < replayed.size(); ++j) { in_order = in_order && replayed[j] == "/f" + to_string(j) + "," + to_string(j); }
+        expect(in_order, "the records came back changed or out of order");
+        sizes.push_back(file_size());
+        if (i == 10) { break; }
+        JournalRecord change(J_TOUCH);
+        change.path = "/f" + to_string(i);
+        change.number = i;
+        log.append(change);
+        log.close();
+    }
+    log.close();
+    //a crash in the middle of the last record
+    expect(truncate(file.c_str(), sizes[10] - 3) == 0, "cannot cut the journal");
+    replayed.clear();
+    expect(log.open(file, 7, collect) == 9, "a torn tail gave " + to_string(replayed.size()) + " records instead of 9");
+    expect(file_size() == sizes[9], "the torn tail was not cut off");
+    JournalRecord after(J_TOUCH);
+    after.path = "/after";
+    log.append(after);
+    log.close();
+    replayed.clear();
+    expect(log.open(file, 7, collect) == 10 && replayed[9] == "/after,0", "the record after a torn tail was lost");
+    log.close();
+    //a flipped byte in the body of the 6th record
+    FILE* damaged = fopen(file.c_str(), "r+b");
+    expect(damaged != nullptr, "cannot open the journal to damage it");
+    fseek(damaged, sizes[6] - 1, SEEK_SET);
+    int byte = fgetc(damaged);
+    fseek(damaged, sizes[6] - 1, SEEK_SET);
+    fputc(byte ^ 0x20, damaged);
+    fclose(damaged);
+    replayed.clear();
+    expect(log.open(file, 7, collect) == 5, "a corrupt record gave " + to_string(replayed.size()) + " records instead of 5");
+    log.close();
+    replayed.clear();
+    expect(log.open(file, 8, collect) == 0, "the journal of another checkpoint was replayed");
+    log.close();
+    unlink(file.c_str());
+}
+
+//Checks what two snapshots see after files are removed and moved between folders: each keeps the children,
+//parents and totals of its time, the tree has the new ones, and dropping the newer snapshot leaves the older
+//one as it was. Removed files are unlinked and reclaimed, as rm and emptybin do, so the bin stays the same
+void VFS::check_snapshot(Inode* folder, Expect& expect) {
+    ostream discard(nullptr);
+    Session session(folder, discard);
+    Inode* a = new_inode("a", folder, Folder, 10, currentTime());
+    Inode* b = new_inode("b", folder, Folder, 10, currentTime());
+    link_child(folder, a);
+    link_child(folder, b);
+    Inode* f1 = new_inode("f1", a, File, 5, currentTime());
+    Inode* f2 = new_inode("f2", a, File, 7, currentTime());
+    link_child(a, f1);
+    link_child(a, f2);
+    //the names of a folder as a snapshot (or the tree) sees them, sorted
+    auto listing = [&](Snapshot* view, Inode* inode) {
+        Vector<Inode*>& children = children_in(view, inode);
+        vector<string> sorted;
+        for (int i = 0; i < children.size(); ++i) { sorted.push_back(children[i]->name.c_str()); }
+        sort(sorted.begin(), sorted.end());
+        string names;
+        for (size_t i = 0; i < sorted.size(); ++i) { names += (i == 0 ? "" : ",") + sorted[i]; }
+        return names;
+    };
+    auto move = [&](Inode* inode, Inode* to) {
+        unlink_child(inode->parent, inode);
+        link_child(to, inode);
+    };
+    try {
+        unsigned long long total0 = folder->total;
+        snapshot(session, CHECK_FOLDER "1", "");
+        Snapshot* s1 = find_snapshot(CHECK_FOLDER "1");
+        unlink_child(a, f1);
+        reclaim(f1);
+        move(f2, b);
+        Inode* f3 = new_inode("f3", a, File, 3, currentTime());
+        link_child(a, f3);
+        unsigned long long total1 = folder->total;
+        snapshot(session, CHECK_FOLDER "2", "");
+        Snapshot* s2 = find_snapshot(CHECK_FOLDER "2");
+        move(f2, a);
+        unlink_child(a, f3);
+        reclaim(f3);
+
+        for (int pass = 0; pass < 2; ++pass) {
+            //the second pass runs once the newer snapshot is dropped, the older one took over what it kept
+            string when = pass == 0 ? "" : " once @" CHECK_FOLDER "2 is dropped";
+            expect(listing(s1, a) == "f1,f2" && listing(s1, b) == "", "@" CHECK_FOLDER "1 sees " + listing(s1, a) + " in a" + when);
+            expect(lookup_in(s1, a, "f1") == f1 && parent_in(s1, f2) == a, "@" CHECK_FOLDER "1 lost a removed or moved file" + when);
+            expect(path_in(s1, f2) == "@" CHECK_FOLDER "1/" CHECK_FOLDER "/a/f2", "@" CHECK_FOLDER "1 sees f2 at " + path_in(s1, f2) + when);
+            expect(total_in(s1, folder) == total0 && total_in(s1, a) == 22 && total_in(s1, b) == 10, "@" CHECK_FOLDER "1 sees other totals" + when);
+            int mismatches = 0;
+            expect(getSize(folder, &mismatches, s1) == total0 && mismatches == 0, "the recount of @" CHECK_FOLDER "1 is wrong" + when);
+            if (pass == 1) { break; }
+            expect(listing(s2, a) == "f3" && listing(s2, b) == "f2", "@" CHECK_FOLDER "2 sees " + listing(s2, a) + " in a");
+            expect(parent_in(s2, f2) == b && total_in(s2, folder) == total1, "@" CHECK_FOLDER "2 sees f2 or the totals wrong");
+            drop_snapshot(s2);
+        }
+        expect(listing(nullptr, a) == "f2" && listing(nullptr, b) == "" && f2->parent == a, "the tree sees " + listing(nullptr, a) + " in a");
+        expect(folder->total == 10 + 10 + 7, "the total of the tree is " + to_string(folder->total));
+        drop_snapshot(s1);
+    } catch (exception &e) {
+        //the snapshots of the check go with it
+        for (int i = snapshots.size() - 1; i >= 0; --i) {
+            if (snapshots[i]->name.compare(0, strlen(CHECK_FOLDER), CHECK_FOLDER) == 0) { drop_snapshot(snapshots[i]); }
+        }
+        throw;
+    }
+}
+
+//Checks the paths of a file 301 levels deep: pwd and find give it whole, resolving it gives the file twice (the
+//second time from the path cache), and once a folder on the way moves the old path leads nowhere
+void VFS::check_paths(Inode* folder, Expect& expect) {
+    const int depth = 300;
+    Vector<Inode*> chain(depth);
+    Inode* node = folder;
+    string expected = "/" CHECK_FOLDER;
+    for (int i = 0; i < depth; ++i) {
+        Inode* next = new_inode("d" + to_string(i), node, Folder, 10, currentTime());
+        link_child(node, next);
+        chain.push_back(next);
+        node = next;
+        expected += "/d" + to_string(i);
+    }
+    Inode* leaf = new_inode(CHECK_FOLDER "leaf", node, File, 1, currentTime());
+    link_child(node, leaf);
+    expected += "/" CHECK_FOLDER "leaf";
+    expect(pwd(leaf) == expected, "pwd gives " + pwd(leaf).substr(0, 60) + "...");
+    ostringstream found;
+    Session session(folder, found);
+    find(session, CHECK_FOLDER "leaf");
+    expect(found.str() == expected + "\n", "find gives " + found.str().substr(0, 60) + "...");
+    Inode* resolved;
+    Inode* parent;
+    for (int pass = 0; pass < 2; ++pass) {
+        expect(resolve(root, expected, resolved, parent) && resolved == leaf && parent == node, "the path doesn't resolve to the file");
+    }
+    //d1 moves up next to d0, the path loses its /d0
+    unlink_child(chain[0], chain[1]);
+    link_child(folder, chain[1]);
+    string moved = "/" CHECK_FOLDER + expected.substr(strlen("/" CHECK_FOLDER "/d0"));
+    expect(!resolve(root, expected, resolved, parent), "the path from before the move still resolves");
+    expect(pwd(leaf) == moved && resolve(root, moved, resolved, parent) && resolved == leaf, "the path after the move is wrong");
+}
+
+//Checks the pages of ls --limit on a folder of 25 files: they cover the folder once in name order, only the
+//last one has no "more" line, a cursor past the end or between names is taken as is, and the files added or
+//removed between two pages neither repeat nor hide the others
+void VFS::check_paging(Inode* folder, Expect& expect) {
+    Vector<Inode*> files(25);
+    for (int i = 0; i < 25; ++i) {
+        Inode* file = new_inode((i < 10 ? "f0" : "f") + to_string(i), folder, File, 1, currentTime());
+        link_child(folder, file);
+        files.push_back(file);
+    }
+    //a page as the names of its rows, and the cursor of its "more" line (empty on the last page)
+    ostringstream out;
+    Session session(folder, out);
+    string cursor;
+    auto page = [&](int limit, const string& after) {
+        out.str(string());
+        ls(session, "--limit", to_string(limit) + (after.empty() ? "" : " --after " + after));
+        istringstream lines(out.str());
+        string line, names;
+        cursor.clear();
+        while (getline(lines, line)) {
+            istringstream fields(line);
+            string type, name;
+            fields >> type >> name;
+            if (type == "--") { cursor = line.substr(line.rfind(' ') + 1); }
+            else { names += (names.empty() ? "" : ",") + name; }
+        }
+        return names;
+    };
+    auto range = [](int from, int to) {
+        string names;
+        for (int i = from; i < to; ++i) { names += (names.empty() ? "" : ",") + string(i < 10 ? "f0" : "f") + to_string(i); }
+        return names;
+    };
+    expect(page(10, "") == range(0, 10) && cursor == "f09", "the first page of 10 is wrong");
+    expect(page(10, cursor) == range(10, 20) && cursor == "f19", "the second page of 10 is wrong");
+    expect(page(10, cursor) == range(20, 25) && cursor.empty(), "the last page is wrong or says there is more");
+    expect(page(25, "") == range(0, 25) && cursor.empty(), "a limit of the whole folder says there is more");
+    expect(page(24, "") == range(0, 24) && cursor == "f23", "a limit of one less than the folder has no more line");
+    expect(page(10, "f24").empty() && cursor.empty(), "the page after the last name is not empty");
+    expect(page(3, "f10a") == range(11, 14), "a cursor between two names doesn't start at the next one");
+    //between two pages: one listed file goes, one comes right after the cursor, one not listed yet goes
+    expect(page(10, "") == range(0, 10), "the first page of 10 is wrong");
+    unlink_child(folder, files[5]);
+    reclaim(files[5]);
+    link_child(folder, new_inode("f095", folder, File, 1, currentTime()));
+    unlink_child(folder, files[12]);
+    reclaim(files[12]);
+    string after_changes = page(10, cursor);
+    expect(after_changes == "f095," + range(10, 12) + "," + range(13, 20), "the page after the changes is " + after_changes);
+    bool refused = false;
+    try {
+        page(0, "");
+    } catch (exception &e) {
+        refused = true;
+    }
+    expect(refused, "a limit of 0 was taken");
+}
+
+//Checks the flat copy of the tree against the Inodes: find scan gives the same paths as find for names and
+//patterns, also right after the tree changes, and its recount of the whole tree matches the cached totals
+void VFS::check_flat(Inode* folder, Expect& expect) {
+    for (int i = 0; i < 30; ++i) {
+        Inode* inner = new_inode("d" + to_string(i), folder, Folder, 10, currentTime());
+        link_child(folder, inner);
+        for (int j = 0; j < 20; ++j) { link_child(inner, new_inode("x" + to_string(j) + ".dat", inner, File, j + 1, currentTime())); }
+        if (i % 3 == 0) { link_child(inner, new_inode(CHECK_FOLDER "common", inner, File, 1, currentTime())); }
+    }
+    ostringstream out;
+    Session session(folder, out);
+    //the output of find with and without scan for each name, the second pass after a change of the tree
+    const char* const searched[] = { CHECK_FOLDER "common", "x1*.dat", "?" CHECK_FOLDER "common", "x7.dat", CHECK_FOLDER "missing" };
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < 5; ++i) {
+            out.str(string());
+            find(session, searched[i]);
+            string indexed = out.str();
+            out.str(string());
+            find(session, searched[i], "scan");
+            string scanned = out.str();
+            string when = pass == 0 ? "" : " after a change";
+            expect(indexed == scanned, string("find scan ") + searched[i] + " differs from find" + when);
+        }
+        int mismatches = 0;
+        expect(flat_size(&mismatches) == root->total && mismatches == 0, "the recount of the flat copy is wrong");
+        if (pass == 1) { break; }
+        Inode* added = new_inode("d30", folder, Folder, 10, currentTime());
+        link_child(folder, added);
+        link_child(added, new_inode(CHECK_FOLDER "common", added, File, 1, currentTime()));
+        Inode* gone = lookup(folder, "d3");
+        unlink_child(folder, gone);
+        reclaim(gone);
+    }
+    out.str(string());
+    find(session, CHECK_FOLDER "common", "scan");
+    expect(out.str().find("/d30/") != string::npos && out.str().find("/d3/") == string::npos, "find scan misses the last changes");
+}
+
+//Checks the glob matching: a table of patterns, ls <pattern> on a small folder (scanned) and a large one
+//(probed through the pattern index) against glob_match, and every SIMD level of the name kernels against
+//the scalar one on random names
+void VFS::check_glob(Inode* folder, Expect& expect) {
+    struct Case { const char* pattern; const char* name; bool match; };
+    static const Case CASES[] = {
+        { "*.txt", "a.txt", true }, { "*.txt", "a.txt.bak", false }, { "*.txt", ".txt", true }, { "a?c", "abc", true },
+        { "a?c", "ac", false }, { "*", "", true }, { "", "", true }, { "", "a", false }, { "?", "", false },
+        { "a*b*c", "aXbYc", true }, { "a*b*c", "aXbY", false }, { "**x", "x", true }, { "*a*a*a", "aaa", true },
+        { "*ab", "aab", true }, { "f?le.*", "file.c", true }, { "f*", "g", false }, { "*.tar.gz", "x.tar.gz", true },
+        { "*.tar.gz", "x.tar.g", false }, { "data??", "data1", false }, { "data??", "data12", true }
+    };
+    for (size_t i = 0; i < sizeof(CASES) / sizeof(CASES[0]); ++i) {
+        const Case& c = CASES[i];
+        bool matched = glob_match(c.pattern, strlen(c.pattern), c.name, strlen(c.name));
+        bool filtered = GlobFilter(c.pattern).match(c.name, strlen(c.name));
+        expect(matched == c.match && filtered == c.match, string(c.pattern) + (c.match ? " doesn't match " : " matches ") + "'" + c.name + "'");
+    }
+    //ls <pattern> gives the matching children sorted by name, in a folder under and over LS_SCAN_MAX entries
+    ostringstream out;
+    Session session(folder, out);
+    const char* const patterns[] = { "*.dat", "x1?.dat", "x*5*", "*.none" };
+    for (int size = 10; size <= 10 * LS_SCAN_MAX; size *= LS_SCAN_MAX) {
+        Inode* inner = new_inode("s" + to_string(size), folder, Folder, 10, currentTime());
+        link_child(folder, inner);
+        vector<string> names;
+        for (int i = 0; i < size; ++i) {
+            names.push_back("x" + to_string(i) + (i % 2 ? ".dat" : ".log"));
+            link_child(inner, new_inode(names.back(), inner, File, 1, currentTime()));
+        }
+        sort(names.begin(), names.end());
+        session.cwd = inner;
+        for (int p = 0; p < 4; ++p) {
+            string expected;
+            for (size_t i = 0; i < names.size(); ++i) {
+                if (glob_match(patterns[p], strlen(patterns[p]), names[i].data(), names[i].length())) { expected += names[i] + ","; }
+            }
+            out.str(string());
+            ls(session, patterns[p], "");
+            istringstream lines(out.str());
+            string line, listed;
+            while (getline(lines, line)) {
+                istringstream fields(line);
+                string type, name;
+                fields >> type >> name;
+                if (type == "File") { listed += name + ","; }
+            }
+            expect(listed == expected, string("ls ") + patterns[p] + " in a folder of " + to_string(size) + " lists other entries");
+        }
+    }
+    //every level of the kernels agrees with the scalar one, over lengths around the vector widths
+    int count;
+    const SimdKernels* levels = simd_levels(count);
+    mt19937 random(2024);
+    const char alphabet[] = "abcXYZ019.._-/ ";
+    for (int round = 0; round < 2000; ++round) {
+        size_t length = random() % 100;
+        string text(length, 'a');
+        for (size_t i = 0; i < length; ++i) { text[i] = alphabet[random() % (sizeof(alphabet) - 1)]; }
+        //mostly valid names, so that the scan goes past the first bytes
+        if (round % 2 == 0) { for (size_t i = 0; i < length; ++i) { if (!isalnum((unsigned char)text[i])) { text[i] = 'q'; } } }
+        string other = text;
+        if (length > 0 && round % 3 == 0) { other[random() % length] ^= 1; }
+        size_t from = length > 0 ? random() % length : 0;
+        string literal = round % 4 == 0 ? "zz" : text.substr(from, min((size_t)(random() % 8 + 1), length - from));
+        size_t scalar_dots = 0;
+        bool scalar_valid = levels[0].charset(text.data(), length, scalar_dots);
+        bool scalar_equal = levels[0].equal(text.data(), other.data(), length);
+        bool scalar_found = levels[0].contains(text.data(), length, literal.data(), literal.length());
+        for (int l = 1; l < count; ++l) {
+            size_t dots = 0;
+            bool valid = levels[l].charset(text.data(), length, dots);
+            expect(valid == scalar_valid && (!valid || dots == scalar_dots), string(levels[l].level) + " charset differs on '" + text + "'");
+            expect(levels[l].equal(text.data(), other.data(), length) == scalar_equal, string(levels[l].level) + " equal differs on '" + text + "'");
+            expect(levels[l].contains(text.data(), length, literal.data(), literal.length()) == scalar_found,
+                   string(levels[l].level) + " contains differs for '" + literal + "' in '" + text + "'");
+        }
+    }
+}
+
+//Function to print the memory used by the Inodes, the interned names and the whole process
+void VFS::stats(Session& session) {
+    ostream& out = *session.out;
+    //flat_lock is taken before pool_lock, like flatten does
+    int flat_count;
+    size_t flat_bytes;
+    bool flat_current;
+    {
+        lock_guard<mutex> guard(flat_lock);
+        flat_count = flat.count();
+        flat_bytes = flat.bytes();
+        flat_current = flat.built && flat.version == tree_version;
+    }
+    lock_guard<mutex> pool_guard(pool_lock);
+    out << "Inodes:         " << inodes.live() << " live in " << inodes.blocks_allocated() << " slab blocks ("
+         << inodes.slots_per_block() << " Inodes of " << sizeof(Inode) << " bytes per " << POOL_BLOCK_BYTES / 1024 << " KiB block)" << endl;
+    out << "Names:          " << names.size() << " distinct, " << names.bytes() / 1024 << " KiB" << endl;
+    {
+        lock_guard<mutex> guard(reclaim_lock);
+        out << "Reclaimed:      " << reclaimed_nodes << " Inodes, " << reclaimed_bytes / 1024 << " KiB"
+             << (reclaim_queue.empty() && !reclaim_busy ? "" : " (still freeing " + to_string(reclaim_queue.size() + (reclaim_busy ? 1 : 0)) + " subtree(s))") << endl;
+    }
+    int cached;
+    unsigned long long hits, misses;
+    path_cache.statistics(cached, hits, misses);
+    out << "Flat copy:      " << flat_count << " Inodes, " << flat_bytes / 1024 << " KiB" << (flat_current ? "" : " (out of date)") << endl;
+    out << "Path cache:     " << cached << " of " << PATH_CACHE_SIZE << " paths, " << hits << " hits, " << misses << " misses" << endl;
+    //resident set size of the process, from /proc/self/statm (second field, in pages)
+    ifstream statm("/proc/self/statm");
+    unsigned long long pages = 0, resident = 0;
+    if (statm >> pages >> resident) {
+        out << "Resident memory: " << resident * sysconf(_SC_PAGESIZE) / 1024 << " KiB" << endl;
+    }
 }
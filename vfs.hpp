@@ -6,49 +6,222 @@
 #include<string>
 #include<ctime>
 #include<fstream>
+#include<cstdio>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<atomic>
+#include<stdexcept>
 #include "inode.hpp"
 #include "queue.hpp"
 #include "vector.hpp"
+#include "image.hpp"
+#include "pool.hpp"
+#include "bin.hpp"
+#include "hashmap.hpp"
+#include "trie.hpp"
+#include "walker.hpp"
+#include "rwlock.hpp"
+#include "session.hpp"
+#include "journal.hpp"
+#include "snapshot.hpp"
+#include "pathcache.hpp"
+#include "flattree.hpp"
+#include "hostscan.hpp"
+#include "commands.hpp"
 using namespace std;
 
+//Children of a folder sorted by name, for the pages of ls. A view of a folder of the tree is valid until the
+//tree changes; one of a folder of a snapshot for as long as the snapshot lives, its children never change
+struct SortedView
+{
+	Inode* folder;					//folder listed
+	unsigned int snapshot;			//id of the snapshot the folder is seen in, 0 for the tree
+	unsigned long long version;		//tree_version the children were sorted at, 0 in a snapshot
+	Vector<Inode*> children;		//children sorted by name
+
+	SortedView() : folder(nullptr), snapshot(0), version(0) {}
+};
+
+//Expectations of a behaviour check (the check command): counts those met, throws at the first one that isn't
+struct Expect
+{
+	string area;					//data structure checked
+	int met;						//expectations met so far
+
+	Expect(const string& a) : area(a), met(0) {}
+	void operator()(bool ok, const string& what) {
+		if (!ok) { throw runtime_error("check " + area + ": " + what); }
+		met++;
+	}
+};
+
 class VFS
 {
 	private:
 		Inode *root;				//root of the VFS
-		Inode *curr_inode;			//current iNode
-		Inode *prev_inode;			//previous iNode
-		Queue<Inode*> bin;			//bin containing the deleted Inodes
-		Queue<string> bin_paths;	//paths of the items in bin
-		Queue<Inode*> bin_parents;  //parents of the items in bin
+		SharedLock tree_lock;		//held for reading by the commands that only read the tree, for writing by the others
+		Vector<Session*> sessions;	//open sessions, changed under tree_lock held for writing
+		Bin bin;					//bin containing the deleted Inodes with their paths and parents
+		int bin_max_items;			//maximum number of items in the bin, 0 for no limit
+		unsigned long long bin_max_bytes;	//maximum total size of the items in the bin, 0 for no limit
+		Image image;				//image the tree was opened from, mapped until all its folders are materialized
+		int lazy_folders;			//number of folders whose children are not materialized yet
+		Pool<Inode> inodes;			//slab allocator of all the Inodes
+		StringPool names;			//interned names of the Inodes
+		mutex pool_lock;			//guards the slab allocator, lazy_folders and by_name, shared with the reclaimer
+		HashMap<Name, Vector<Inode*> > by_name;	//every allocated Inode, by name (the Inodes in the bin included)
+		NameTrie patterns;			//every name interned so far, for the glob searches
+		Walker walker;				//parallel traversal engine of the whole-tree operations
+		mutex walk_lock;			//held by the walk using the shared walker, the others walk on their own thread
+		Journal journal;			//changes made since the last checkpoint, replayed after a crash
+		uint64_t checkpoint_id;		//checkpoint of the image the journal follows, 0 for the tree of VFS_FILE
+		unsigned long long last_record;	//end of the journal record of the last command, 0 if it recorded nothing
+		Vector<Snapshot*> snapshots;	//snapshots of the tree, oldest first
+		unsigned int snapshot_clock;	//id of the last snapshot taken
+		Vector<Retired> retired;		//subtrees emptied from the bin that snapshots may still see
+		PathCache path_cache;			//recently resolved absolute paths, forgotten whenever a link is removed
+		unsigned long long tree_version;	//changes with every link, unlink and total of the tree
+		FlatTree flat;					//copy of the tree in arrays for the whole-tree scans
+		mutex flat_lock;				//one reader copies the tree into flat at a time
+		Vector<SortedView> sorted_views;	//the last folders paged through by ls
+		int next_view;					//view replaced by the next folder
+		mutex views_lock;				//guards the views, readers page through folders at the same time
+
+		//Reclamation of the subtrees emptied from the bin, done by a background thread
+		thread reclaimer;					//background thread freeing the subtrees
+		mutex reclaim_lock;					//guards the fields below
+		condition_variable reclaim_ready;	//wakes the reclaimer up when there is work or on shutdown
+		Vector<Inode*> reclaim_queue;		//detached subtrees waiting to be freed
+		bool reclaim_busy;					//true while the reclaimer is freeing a subtree
+		bool reclaim_stop;					//asks the reclaimer to stop
+		atomic<unsigned long long> reclaimed_nodes;	//number of Inodes freed so far
+		atomic<unsigned long long> reclaimed_bytes;	//memory freed so far (Inodes, children arrays, indexes)
 	
 	public:	 	
 		//Required methods
 		VFS();	
-		void help();						
-		string pwd(Inode* node = nullptr) const;
-		void ls(string extension);						
-		void mkdir(string folder_name);
-		void touch(string file_name, unsigned int size);
-		void cd(string path);
-		void rm(string name);
-		void size(string path);
-		void showbin();
-		void emptybin();
-		void exit();
+		~VFS();
+		Session* open_session(ostream& out);
+		void close_session(Session* session);
+		bool execute(Session& session, const string& command, const string& parameter1, const string& parameter2);
+		bool dispatch(Session& session, Opcode opcode, const string& parameter1, const string& parameter2);
+		void help(Session& session);
+		string pwd(Inode* node) const;
+		string pwd(const Session& session);
+		void ls(Session& session, string extension, string key = "");
+		void mkdir(Session& session, string folder_name);
+		void touch(Session& session, string file_name, unsigned int size);
+		void cd(Session& session, string path);
+		void rm(Session& session, string name);
+		void size(Session& session, string path, string mode = "");
+		void showbin(Session& session);
+		void emptybin(Session& session);
+		void binlimit(Session& session, string items, string bytes);
+		void exit(Session& session);
+		void stats(Session& session);
+		void export_dat(Session& session, string filename);
+		void threads(Session& session, string count);
+		void bench(Session& session, string path, string levels = "");
+		void check(Session& session, string area);
+		void checkpoint(Session& session);
+		void journal_mode(Session& session, string mode);
+		void close_journal();
+		void snapshot(Session& session, string name, string mode);
+		void import(Session& session, string folder_path);
+		HostScan* scan_host(const string& host_path);
 
 		//My helper methods
-		string currentTime();
+		int64_t currentTime();
 		bool correct_name(string name);
-		bool repeated_name(string name);
-		Inode* getNode(string path);
-		Inode* getParent(string path);
-		int getSize(Inode* inode);
+		bool correct_name(const char* name, size_t length);
+		bool repeated_name(Inode* folder, string name);
+		Inode* getNode(Inode* base, string path);
+		Inode* getParent(Inode* base, string path);
+		bool resolve(Inode* base, const string& path, Inode*& node, Inode*& parent);
+		Name intern(const char* name, size_t length);
+		Inode* new_inode(const string& name, Inode* parent, bool type, unsigned int size, int64_t created);
+		Inode* make_inode(Name name, Inode* parent, bool type, unsigned int size, int64_t created, bool from_image);
+		int64_t image_created(const ImageRecord& record);
+		void reclaim(Inode* inode);
+		void free_subtree(Inode* inode);
+		void reclaim_loop();
+		bool is_inside(Inode* node, Inode* ancestor) const;
+		Inode* lookup(Inode* folder, const string& name);
+		Inode* lookup(Inode* folder, const char* name, size_t length);
+		void link_child(Inode* folder, Inode* child);
+		void insert_child(Inode* folder, Inode* child);
+		void unlink_child(Inode* folder, Inode* child);
+		unsigned long long getSize(Inode* inode, int* mismatches = nullptr, Snapshot* view = nullptr);
+		void load(const string& filename);
+		bool load_line(const char* line, size_t length, Vector<Inode*>& stack, Vector<unsigned long long>& stored, int& depth);
+		void finish_loaded(Inode* inode, unsigned long long stored_size);
+		void convert_to_folder(Inode* inode);
+		bool open_image(const string& filename);
+		void expand(Inode* folder);
+		Vector<Inode*>& children_of(Inode* folder);
+		void save_image(const string& filename, uint64_t checkpoint);
+		Inode* image_inode(uint32_t index, HashMap<long long, Inode*>& bin_roots);
+		void save_checkpoint();
+		void compact_names();
+		void log_change(const JournalRecord& change);
+		void replay(Session& session, const JournalRecord& change);
+		void save(const string& filename, Snapshot* view = nullptr);
+		bool save_helper(Inode* inode, string& path, string& buffer, FILE* out, Snapshot* view);
+		void add_total(Inode* folder, long long delta);
+		void bench_deep(Session& session, int levels);
+		void bench_ls(Session& session);
+		void bench_create(Session& session, int count);
+		void bench_journal(Session& session, int count);
+		void bench_cp(Session& session, int count);
+		void bench_fanout(Session& session, int max);
+		void bench_vector(Session& session, int count);
+		void bench_scan(Session& session, string pattern);
+		void bench_simd(Session& session);
+		void check_index(Inode* folder, Expect& expect);
+		void check_vector(Inode* folder, Expect& expect);
+		void check_walker(Inode* folder, Expect& expect);
+		void check_journal(Inode* folder, Expect& expect);
+		void check_snapshot(Inode* folder, Expect& expect);
+		void check_paths(Inode* folder, Expect& expect);
+		void check_paging(Inode* folder, Expect& expect);
+		void check_flat(Inode* folder, Expect& expect);
+		void check_glob(Inode* folder, Expect& expect);
+		Vector<Inode*>& sorted_children(Session& session, Vector<Inode*>& children);
+		static void put_row(string& buffer, Inode* inode, size_t name_width);
+		static void print_rows(ostream& out, Inode* const* rows, int count, size_t name_width);
 		
 		//My Optional Mehods
-		void find(string name);
-		void find_helper(Inode *ptr, string name);
-		void mv(string file, string folder);
-		void recover();
+		void find(Session& session, string name, string mode = "");
+		void find_helper(Inode *ptr, const string& name, Vector<string>& paths, Snapshot* view = nullptr);
+		void find_paths(Name name, Vector<string>& paths);
+		void find_newer(Session& session, const string& reference);
+		void flatten();
+		unsigned long long flat_size(int* mismatches);
+		void flat_find(const string& name, Vector<string>& paths);
+		void index_name(Inode* inode);
+		void unindex_name(Inode* inode);
+		void walk(Inode* inode, const WalkVisitor& visit);
+		void materialize(Inode* inode);
+		bool fully_expanded();
+		void find_unexpanded(const string& name, Vector<string>& paths);
+		void release_image();
+		void mv(Session& session, string file, string folder);
+		void cp(Session& session, string first, string rest);
+		Inode* copy_subtree(Inode* source, Inode* folder, int64_t created);
+		void recover(Session& session, string path = "");
+		void purge_bin();
+		void freeze(Inode* inode);
+		void freeze_children(Inode* folder);
+		Frozen* frozen_state(Snapshot* view, Inode* inode, bool children);
+		Vector<Inode*>& children_in(Snapshot* view, Inode* folder);
+		unsigned long long total_in(Snapshot* view, Inode* inode);
+		Inode* parent_in(Snapshot* view, Inode* inode);
+		Inode* lookup_in(Snapshot* view, Inode* folder, const string& name);
+		Inode* node_in(Snapshot* view, Inode* base, const string& path);
+		string path_in(Snapshot* view, Inode* inode);
+		Snapshot* find_snapshot(const string& name);
+		void drop_snapshot(Snapshot* view);
 
 };
 //===========================================================
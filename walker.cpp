@@ -0,0 +1,187 @@
+#include<cstdlib>
+#include<thread>
+#include<mutex>
+#include<chrono>
+
+#include "vfs.hpp"
+#include "walker.hpp"
+
+using namespace std;
+
+Walker::Walker(int thread_count) : workers(0), deques(nullptr), pool(nullptr), started(false),
+    generation(0), running(0), stop(false), visitor(nullptr), pending(0) {
+    set_threads(thread_count);
+}
+
+Walker::~Walker() {
+    shutdown();
+    delete[] deques;
+}
+
+void Walker::set_threads(int thread_count) {
+    if (thread_count < 0 || thread_count > WALK_MAX_THREADS) {
+        throw runtime_error("The number of threads must be between 0 (one per core) and " + to_string(WALK_MAX_THREADS));
+    }
+    if (thread_count == 0) {
+        thread_count = (int)thread::hardware_concurrency();
+        if (thread_count < 1) { thread_count = 1; }
+        if (thread_count > WALK_MAX_THREADS) { thread_count = WALK_MAX_THREADS; }
+    }
+    if (thread_count == workers) { return; }
+    //the threads are started again with the new count on the next walk
+    shutdown();
+    delete[] deques;
+    workers = thread_count;
+    deques = new Deque[workers];
+    for (int i = 0; i < workers; ++i) { deques[i].head = 0; }
+}
+
+void Walker::start() {
+    stop = false;
+    pool = new thread[workers - 1];
+    for (int i = 1; i < workers; ++i) { pool[i - 1] = thread(&Walker::thread_loop, this, i); }
+    started = true;
+}
+
+void Walker::shutdown() {
+    if (!started) { return; }
+    {
+        lock_guard<mutex> guard(lock);
+        stop = true;
+    }
+    wake.notify_all();
+    for (int i = 0; i < workers - 1; ++i) { pool[i].join(); }
+    delete[] pool;
+    pool = nullptr;
+    started = false;
+}
+
+void Walker::walk(Inode* root, const WalkVisitor& visit) {
+    if (root == nullptr) { return; }
+    if (workers > 1 && !started) { start(); }
+    visitor = &visit;
+    error = nullptr;
+    Task first = { root, nullptr, 0, 0 };
+    pending = 0;
+    push(0, first);
+    if (workers > 1) {
+        {
+            lock_guard<mutex> guard(lock);
+            running = workers - 1;
+            generation++;
+        }
+        wake.notify_all();
+    }
+    work(0);
+    //wait for the threads to leave the walk, so that none of them still reads the visitor
+    if (workers > 1) {
+        unique_lock<mutex> guard(lock);
+        while (running > 0) { done.wait(guard); }
+    }
+    visitor = nullptr;
+    if (error) { rethrow_exception(error); }
+}
+
+void Walker::thread_loop(int id) {
+    long long seen = 0;
+    while (true) {
+        {
+            unique_lock<mutex> guard(lock);
+            while (!stop && generation == seen) { wake.wait(guard); }
+            if (stop) { return; }
+            seen = generation;
+        }
+        work(id);
+        {
+            lock_guard<mutex> guard(lock);
+            if (--running == 0) { done.notify_all(); }
+        }
+    }
+}
+
+void Walker::work(int id) {
+    Task task;
+    int idle = 0;
+    while (true) {
+        if (pop(id, task) || steal(id, task)) {
+            idle = 0;
+            try {
+                run(id, task);
+            } catch (...) {
+                //keep the first error, the rest of the walk still runs so that pending goes back to 0
+                lock_guard<mutex> guard(lock);
+                if (!error) { error = current_exception(); }
+            }
+            pending--;
+            continue;
+        }
+        //nothing to take: the walk is over once no task is left anywhere
+        if (pending.load() == 0) { return; }
+        if (++idle < 64) { this_thread::yield(); }
+        else { this_thread::sleep_for(chrono::microseconds(50)); }
+    }
+}
+
+void Walker::run(int id, Task& task) {
+    if (task.list == nullptr) {
+        //a single Inode, the root of the walk
+        Vector<Inode*>* children = (*visitor)(task.node, id);
+        if (children != nullptr && !children->empty()) {
+            Task next = { nullptr, children, 0, children->size() };
+            push(id, next);
+        }
+        return;
+    }
+    //give away the upper halves of a long range, the thieves take the largest ones first
+    while (task.end - task.begin > WALK_SPLIT) {
+        int middle = task.begin + (task.end - task.begin) / 2;
+        Task upper = { nullptr, task.list, middle, task.end };
+        push(id, upper);
+        task.end = middle;
+    }
+    for (int i = task.begin; i < task.end; ++i) {
+        Vector<Inode*>* children = (*visitor)((*task.list)[i], id);
+        //the children become a task of their own instead of a recursive call, deep trees don't grow the stack
+        if (children != nullptr && !children->empty()) {
+            Task next = { nullptr, children, 0, children->size() };
+            push(id, next);
+        }
+    }
+}
+
+void Walker::push(int id, const Task& task) {
+    pending++;
+    Deque& deque = deques[id];
+    lock_guard<mutex> guard(deque.lock);
+    deque.tasks.push_back(task);
+}
+
+// Takes the newest task of a worker's own deque
+bool Walker::pop(int id, Task& task) {
+    Deque& deque = deques[id];
+    lock_guard<mutex> guard(deque.lock);
+    if (deque.tasks.size() == deque.head) { return false; }
+    task = deque.tasks.back();
+    deque.tasks.pop_back();
+    if (deque.tasks.size() == deque.head) {
+        deque.tasks.clear();
+        deque.head = 0;
+    }
+    return true;
+}
+
+// Takes the oldest task of another worker, trying them all once starting after the thief
+bool Walker::steal(int id, Task& task) {
+    for (int k = 1; k < workers; ++k) {
+        Deque& deque = deques[(id + k) % workers];
+        lock_guard<mutex> guard(deque.lock);
+        if (deque.tasks.size() == deque.head) { continue; }
+        task = deque.tasks[deque.head++];
+        if (deque.tasks.size() == deque.head) {
+            deque.tasks.clear();
+            deque.head = 0;
+        }
+        return true;
+    }
+    return false;
+}
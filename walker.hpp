@@ -0,0 +1,76 @@
+#ifndef WALKER_H
+#define WALKER_H
+#include<cstdlib>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<atomic>
+#include<functional>
+#include<exception>
+#include "vector.hpp"
+
+using namespace std;
+
+#define WALK_SPLIT 64					//children ranges longer than this are split in halves for the thieves
+#define WALK_MAX_THREADS 256			//upper bound of the thread-count option
+
+class Inode;
+
+//Visitor of a parallel walk: called once for every Inode with the index of the worker calling it,
+//returns the children to walk into, or nullptr for none. The children must not change during the walk.
+typedef function<Vector<Inode*>*(Inode*, int)> WalkVisitor;
+
+//Work-stealing traversal engine: a pool of workers, each with its own deque of tasks. A task is a
+//range of the children of a folder; its owner takes tasks from the back of its deque, idle workers
+//steal from the front of the others, where the largest ranges are. The thread calling walk is
+//worker 0, so a walker with one thread never starts any.
+class Walker
+{
+	private:
+		struct Task {
+			Inode* node;				//single Inode to visit, when list is nullptr
+			Vector<Inode*>* list;		//children being visited
+			int begin;					//first child of the range
+			int end;					//past the last child of the range
+		};
+		struct Deque {
+			mutex lock;					//guards tasks and head
+			Vector<Task> tasks;			//tasks of the worker, the front ones from head on are the oldest
+			int head;					//index of the oldest task still in the deque
+		};
+
+		int workers;					//number of workers, including the calling thread
+		Deque* deques;					//one deque per worker
+		thread* pool;					//workers 1 to workers-1, started on the first walk
+		bool started;					//true once the threads are started
+		mutex lock;						//guards generation, running, stop and error
+		condition_variable wake;		//starts the threads on a new walk or stops them
+		condition_variable done;		//tells walk that the last thread left the current walk
+		long long generation;			//number of the current walk
+		int running;					//threads still working on the current walk
+		bool stop;						//asks the threads to stop
+		exception_ptr error;			//first exception thrown by the visitor during the current walk
+		const WalkVisitor* visitor;		//visitor of the current walk
+		atomic<long long> pending;		//tasks pushed and not finished yet, the walk ends at 0
+
+		void start();					//Start the threads
+		void shutdown();				//Stop and join the threads
+		void thread_loop(int id);		//Body of the threads: wait for a walk, work on it, repeat
+		void work(int id);				//Run and steal tasks until the walk is finished
+		void run(int id, Task& task);	//Run a task, splitting large ranges first
+		void push(int id, const Task& task);
+		bool pop(int id, Task& task);
+		bool steal(int id, Task& task);
+
+	public:
+		Walker(int thread_count = 0);
+		~Walker();
+		Walker(const Walker&) = delete;
+		Walker& operator=(const Walker&) = delete;
+
+		void walk(Inode* root, const WalkVisitor& visit);	//Visit a subtree in parallel, rethrows the first exception of the visitor
+		void set_threads(int thread_count);		//Change the number of workers, 0 for the number of cores
+		int threads() const { return workers; }
+};
+
+#endif